@@ -0,0 +1,434 @@
+#include "mcts.h"
+#include "rng.h"
+#include "search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Move generator checks and engine benchmarks. Every run uses the same positions and
+// iteration counts, and timings are the best of several repetitions, so that the output can
+// be compared from one commit to the next.
+
+constexpr int BENCH_REPETITIONS = 5;
+constexpr int BENCH_SAMPLE_COUNT = 1024;
+constexpr int BENCH_ROUNDS = 2000;
+constexpr uint64_t BENCH_SEED = 1;
+
+volatile uint64_t bench_sink;
+
+struct perft_case_t {
+	char const *name;
+	std::vector<std::pair<int, int>> moves; // (position, size), starting with player 1
+	std::vector<uint64_t> expected; // undecided positions from depth 1
+};
+
+std::vector<perft_case_t> const perft_cases = {
+		{"clear",   {},                                                 {27, 675, 14913, 301104, 4295616}},
+		{"opening", {{4, 2}, {0, 2}},                                   {21, 399, 4957, 56878, 326574}},
+		{"gobbles", {{4, 0}, {4, 1}, {0, 1}, {0, 2}, {8, 0}},           {18, 216, 1612, 11512, 37654, 112900}},
+		{"late",    {{0, 0}, {0, 1}, {4, 0}, {4, 2}, {8, 1}, {2, 0}},   {13, 119, 867, 3115, 9151}},
+};
+
+std::vector<perft_case_t> const large_perft_cases = {
+		{"4x4",     {},                                                 {64, 3936, 226624}},
+		{"4x4 mid", {{5, 3}, {10, 3}, {0, 1}, {0, 2}, {15, 0}, {6, 1}, {9, 0}}, {46, 1884, 74176, 2463348}},
+};
+
+std::vector<perft_case_t> const wide_perft_cases = {
+		{"7x6",     {},                                                {168, 27804, 4491144}},
+		{"7x6 mid", {{24, 3}, {17, 2}, {23, 1}, {25, 2}, {22, 0}},      {153, 21854, 2982882}},
+};
+
+// Plays the moves of a case from the empty board, and returns the player to move
+template<typename config_t>
+int play_case_moves(basic_game_state_t<config_t> &state, std::vector<std::pair<int, int>> const &moves) {
+	state = get_clear_game_state<config_t>();
+	int player = 0;
+	for (auto const &move: moves) {
+		state = *perform_move(state, {player, move.second, move.first, false});
+		player = 1 - player;
+	}
+	return player;
+}
+
+// Undecided positions at exactly `depth` plies. Decided games are neither expanded nor
+// counted, even when decided at `depth`, and a player without a valid move has to yield.
+template<typename config_t>
+uint64_t perft(basic_position_t<config_t> &position, int player, int depth) {
+	if (get_victor(position.state) != -1) {
+		return 0;
+	}
+	if (depth == 0) {
+		return 1;
+	}
+
+	basic_move_list_t<config_t> moves;
+	generate_moves(position.state, player, moves);
+	if (moves.empty()) {
+		moves.push({player, -1, -1, true});
+	}
+
+	uint64_t nodes = 0;
+	for (auto const &move: moves) {
+		basic_undo_t<config_t> undo;
+		make_move(position, move, undo);
+		nodes += perft(position, 1 - player, depth - 1);
+		unmake_move(position, move, undo);
+	}
+	return nodes;
+}
+
+// The same count through get_valid_moves and perform_move, as a cross-check
+template<typename config_t>
+uint64_t perft_copy(basic_game_state_t<config_t> const &state, int player, int depth) {
+	if (get_victor(state) != -1) {
+		return 0;
+	}
+	if (depth == 0) {
+		return 1;
+	}
+
+	auto moves = get_valid_moves(state, player);
+	if (moves.empty()) {
+		moves.push_back({player, -1, -1, true});
+	}
+
+	uint64_t nodes = 0;
+	for (auto const &move: moves) {
+		nodes += perft_copy(*perform_move(state, move), 1 - player, depth - 1);
+	}
+	return nodes;
+}
+
+double get_seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename config_t>
+bool run_perft_cases(std::vector<perft_case_t> const &cases) {
+	bool passed = true;
+	for (auto const &perft_case: cases) {
+		basic_game_state_t<config_t> state;
+		int player = play_case_moves(state, perft_case.moves);
+
+		for (size_t i = 0; i < perft_case.expected.size(); ++i) {
+			int depth = (int) i + 1;
+			basic_position_t<config_t> position = get_position(state);
+			auto start = std::chrono::steady_clock::now();
+			uint64_t nodes = perft(position, player, depth);
+			double seconds = get_seconds_since(start);
+
+			start = std::chrono::steady_clock::now();
+			uint64_t copy_nodes = perft_copy(state, player, depth);
+			double copy_seconds = get_seconds_since(start);
+
+			bool ok = nodes == perft_case.expected[i] && copy_nodes == nodes;
+			passed = passed && ok;
+			printf("%-8s %5i %12llu %12llu %10.2f %10.2f  %s\n", perft_case.name, depth, (unsigned long long) nodes,
+			       (unsigned long long) perft_case.expected[i], nodes / std::max(seconds, 1e-9) / 1e6,
+			       copy_nodes / std::max(copy_seconds, 1e-9) / 1e6, ok ? "ok" : "MISMATCH");
+		}
+	}
+	return passed;
+}
+
+bool run_perft() {
+	printf("%-8s %5s %12s %12s %10s %10s  %s\n", "perft", "depth", "nodes", "expected", "Mnodes/s", "copy Mn/s", "result");
+	bool passed = run_perft_cases<classic_config_t>(perft_cases);
+	passed = run_perft_cases<large_config_t>(large_perft_cases) && passed;
+	passed = run_perft_cases<wide_config_t>(wide_perft_cases) && passed;
+	printf("\n");
+	return passed;
+}
+
+struct bench_sample_t {
+	game_state_t state;
+	int player;
+	move_t move;
+};
+
+// Undecided positions from random games, each with one of its valid moves
+std::vector<bench_sample_t> get_bench_samples() {
+	rng_t rng(BENCH_SEED);
+	std::vector<bench_sample_t> samples;
+	while (samples.size() < BENCH_SAMPLE_COUNT) {
+		game_state_t state = get_clear_game_state();
+		int player = 0;
+		int plies = (int) rng.next_below(10);
+		for (int i = 0; i < plies && get_victor(state) == -1; ++i) {
+			move_list_t moves;
+			generate_moves(state, player, moves);
+			if (moves.empty()) break;
+			state = *perform_move(state, moves[(int) rng.next_below(moves.count)]);
+			player = 1 - player;
+		}
+
+		move_list_t moves;
+		generate_moves(state, player, moves);
+		if (get_victor(state) == -1 && !moves.empty()) {
+			samples.push_back({state, player, moves[(int) rng.next_below(moves.count)]});
+		}
+	}
+	return samples;
+}
+
+// Runs `body` over all samples BENCH_ROUNDS times and reports the best time per call
+void run_micro(char const *name, std::vector<bench_sample_t> const &samples,
+               std::function<uint64_t(bench_sample_t const &)> const &body) {
+	double best = 1e30;
+	for (int repetition = 0; repetition < BENCH_REPETITIONS; ++repetition) {
+		uint64_t sink = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int round = 0; round < BENCH_ROUNDS; ++round) {
+			for (auto const &sample: samples) {
+				sink += body(sample);
+			}
+		}
+		best = std::min(best, get_seconds_since(start));
+		bench_sink = sink;
+	}
+
+	printf("%-24s %10.2f ns/op\n", name, best * 1e9 / ((double) BENCH_ROUNDS * samples.size()));
+}
+
+void run_micro_benchmarks() {
+	auto samples = get_bench_samples();
+	std::vector<position_t> positions;
+	for (auto const &sample: samples) {
+		positions.push_back(get_position(sample.state));
+	}
+
+	printf("%-24s %13s\n", "benchmark", "time");
+	run_micro("baseline (empty body)", samples, [](bench_sample_t const &sample) {
+		return sample.state.words[0];
+	});
+	run_micro("get_valid_moves", samples, [](bench_sample_t const &sample) {
+		return get_valid_moves(sample.state, sample.player).size();
+	});
+	run_micro("generate_moves", samples, [](bench_sample_t const &sample) {
+		move_list_t moves;
+		generate_moves(sample.state, sample.player, moves);
+		return (uint64_t) moves.count;
+	});
+	run_micro("perform_move", samples, [](bench_sample_t const &sample) {
+		return perform_move(sample.state, sample.move)->words[0];
+	});
+	run_micro("make_move+unmake_move", samples, [&](bench_sample_t const &sample) {
+		position_t &position = positions[&sample - samples.data()];
+		undo_t undo;
+		make_move(position, sample.move, undo);
+		uint64_t hash = position.hashes[0];
+		unmake_move(position, sample.move, undo);
+		return hash;
+	});
+	run_micro("get_victor", samples, [](bench_sample_t const &sample) {
+		return (uint64_t) get_victor(sample.state);
+	});
+	run_micro("std::hash<game_state_t>", samples, [](bench_sample_t const &sample) {
+		return (uint64_t) std::hash<game_state_t>()(sample.state);
+	});
+	run_micro("get_canonical_state", samples, [](bench_sample_t const &sample) {
+		return get_canonical_state(sample.state).state.words[0];
+	});
+	run_micro("get_canonical_hash", samples, [&](bench_sample_t const &sample) {
+		return get_canonical_hash(positions[&sample - samples.data()]).hash;
+	});
+	printf("\n");
+}
+
+struct search_case_t {
+	char const *name;
+	std::vector<std::pair<int, int>> moves;
+};
+
+// Single-threaded iterative deepening, as smarter_ai runs it, from an empty cache
+template<typename config_t>
+void run_search_cases(transposition_table_t &table, std::vector<search_case_t> const &cases,
+                      std::vector<int> const &depths) {
+	for (auto const &search_case: cases) {
+		basic_game_state_t<config_t> state;
+		int player = play_case_moves(state, search_case.moves);
+
+		for (int depth: depths) {
+			double best = 1e30;
+			uint64_t nodes = 0;
+			int score = 0;
+			for (int repetition = 0; repetition < BENCH_REPETITIONS; ++repetition) {
+				table.clear();
+				search_context_t context;
+				context.cache = &table;
+				auto start = std::chrono::steady_clock::now();
+				score = search_iteratively(context, state, player, 1, depth).second;
+				best = std::min(best, get_seconds_since(start));
+				nodes = context.nodes;
+			}
+			printf("%-8s %5i %12llu %10.3f %10.2f %9i\n", search_case.name, depth, (unsigned long long) nodes,
+			       best * 1e3, nodes / std::max(best, 1e-9) / 1e6, score);
+		}
+	}
+}
+
+void run_search_benchmarks() {
+	transposition_table_t table(DEFAULT_TRANSPOSITION_TABLE_MB);
+	printf("%-8s %5s %12s %10s %10s %9s\n", "search", "depth", "nodes", "ms", "Mnodes/s", "score");
+	run_search_cases<classic_config_t>(table, {
+			{"clear",   {}},
+			{"opening", {{4, 2}, {0, 2}}},
+			{"late",    {{0, 0}, {0, 1}, {4, 0}, {4, 2}, {8, 1}, {2, 0}}},
+	}, {2, 4, 6, 8, MAX_PLY});
+	run_search_cases<large_config_t>(table, {{"4x4", {}}}, {2, 4, 6});
+	run_search_cases<wide_config_t>(table, {{"7x6", {}}}, {2, 4});
+	printf("\n");
+}
+
+constexpr int BENCH_PLAYOUTS = 1 << 20;
+
+// Outcome probabilities of uniformly random play for the player to move: a loss, a draw, a win
+struct random_play_outcome_t {
+	double probabilities[3];
+};
+
+// Exact distribution of the results the playouts sample, by enumerating every game. The
+// player to move follows from the pieces left, so positions are memoized by canonical state.
+random_play_outcome_t get_random_play_outcome(game_state_t const &state, int player,
+                                              std::unordered_map<game_state_t, random_play_outcome_t> &memo) {
+	int victor = get_victor(state);
+	if (victor != -1) {
+		random_play_outcome_t outcome = {};
+		outcome.probabilities[victor == 2 ? 1 : victor == player ? 2 : 0] = 1;
+		return outcome;
+	}
+
+	game_state_t key = get_canonical_state(state).state;
+	auto it = memo.find(key);
+	if (it != memo.end()) {
+		return it->second;
+	}
+
+	move_list_t moves;
+	generate_moves(state, player, moves);
+	if (moves.empty()) {
+		moves.push({player, -1, -1, true});
+	}
+	random_play_outcome_t outcome = {};
+	for (auto const &move: moves) {
+		auto child = get_random_play_outcome(*perform_move(state, move), 1 - player, memo);
+		for (int i = 0; i < 3; ++i) {
+			outcome.probabilities[i] += child.probabilities[2 - i] / moves.count;
+		}
+	}
+	memo[key] = outcome;
+	return outcome;
+}
+
+// The playouts implement the rules a second time, in vector form. Their mean result has to
+// be within 5 standard errors of the exact one, for a fixed seed.
+template<typename lanes_t>
+bool run_rollout_benchmark(char const *lanes_name, char const *case_name, game_state_t const &state, int player,
+                           random_play_outcome_t const &exact) {
+	lane_rng_t<lanes_t> rng;
+	rng.seed(BENCH_SEED);
+	double best = 1e30;
+	uint64_t total = 0;
+	for (int repetition = 0; repetition < BENCH_REPETITIONS; ++repetition) {
+		auto start = std::chrono::steady_clock::now();
+		total = run_rollouts(rng, state, player, BENCH_PLAYOUTS / lanes_t::COUNT);
+		best = std::min(best, get_seconds_since(start));
+	}
+	double mean = total / (2.0 * BENCH_PLAYOUTS);
+	double exact_mean = (exact.probabilities[1] + 2 * exact.probabilities[2]) / 2;
+	double variance = (exact.probabilities[1] + 4 * exact.probabilities[2]) / 4 - exact_mean * exact_mean;
+	bool ok = std::abs(mean - exact_mean) <= 5 * std::sqrt(variance / BENCH_PLAYOUTS);
+	printf("%-8s %-8s %12i %10.3f %10.2f %9.4f %9.4f  %s\n", lanes_name, case_name, BENCH_PLAYOUTS, best * 1e3,
+	       BENCH_PLAYOUTS / best / 1e6, mean, exact_mean, ok ? "ok" : "MISMATCH");
+	return ok;
+}
+
+// Random playouts with every lane width the build supports, checked against the exact
+// mean, then whole MCTS moves
+bool run_mcts_benchmarks() {
+	bool passed = true;
+	std::unordered_map<game_state_t, random_play_outcome_t> memo;
+	printf("%-8s %-8s %12s %10s %10s %9s %9s  %s\n", "playouts", "position", "games", "ms", "Mgames/s", "mean",
+	       "exact", "result");
+	for (auto const &perft_case: perft_cases) {
+		game_state_t state;
+		int player = play_case_moves(state, perft_case.moves);
+		auto exact = get_random_play_outcome(state, player, memo);
+		passed = run_rollout_benchmark<scalar_lanes_t>("scalar", perft_case.name, state, player, exact) && passed;
+#if defined(__SSE2__)
+		passed = run_rollout_benchmark<sse2_lanes_t>("sse2", perft_case.name, state, player, exact) && passed;
+#endif
+#if defined(__AVX2__)
+		passed = run_rollout_benchmark<avx2_lanes_t>("avx2", perft_case.name, state, player, exact) && passed;
+#endif
+	}
+	printf("\n");
+
+	game_state_t clear = get_clear_game_state();
+
+	printf("%-8s %12s %10s %10s\n", "mcts", "playouts", "ms", "Mgames/s");
+	for (int playouts: {10000, 100000, 1000000}) {
+		mcts_options_t options;
+		options.playouts = playouts;
+		double best = 1e30;
+		uint64_t played = 0;
+		for (int repetition = 0; repetition < BENCH_REPETITIONS; ++repetition) {
+			mcts_t mcts(options, BENCH_SEED);
+			auto start = std::chrono::steady_clock::now();
+			mcts.get_move(clear, 0);
+			best = std::min(best, get_seconds_since(start));
+			played = mcts.playouts;
+		}
+		printf("%-8s %12llu %10.3f %10.2f\n", "clear", (unsigned long long) played, best * 1e3, played / best / 1e6);
+	}
+	printf("\n");
+	return passed;
+}
+
+int main(int argc, char **argv) {
+	bool perft_enabled = true, micro_enabled = true, search_enabled = true, mcts_enabled = true;
+	if (argc > 1) {
+		perft_enabled = micro_enabled = search_enabled = mcts_enabled = false;
+		for (int i = 1; i < argc; ++i) {
+			if (strcmp(argv[i], "perft") == 0) {
+				perft_enabled = true;
+			} else if (strcmp(argv[i], "micro") == 0) {
+				micro_enabled = true;
+			} else if (strcmp(argv[i], "search") == 0) {
+				search_enabled = true;
+			} else if (strcmp(argv[i], "mcts") == 0) {
+				mcts_enabled = true;
+			} else {
+				printf("Usage: %s [perft] [micro] [search] [mcts]\n", argv[0]);
+				return 1;
+			}
+		}
+	}
+
+	bool passed = true;
+	if (perft_enabled) {
+		passed = run_perft();
+	}
+	if (micro_enabled) {
+		run_micro_benchmarks();
+	}
+	if (search_enabled) {
+		run_search_benchmarks();
+	}
+	if (mcts_enabled) {
+		passed = run_mcts_benchmarks() && passed;
+	}
+
+	if (!passed) {
+		printf("Perft or playout mismatch\n");
+		return 1;
+	}
+	return 0;
+}
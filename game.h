@@ -0,0 +1,790 @@
+#pragma once
+
+#include "rng.h"
+
+#include <xxhash.h>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Longest game of any variant, in plies, for tables shared by all of them
+constexpr int MAX_GAME_PLY = 64;
+
+// The rules of a variant: the board, the length of a winning line and the piece set. The
+// state layout, the lookup tables and every function below are specialized on the variant
+// at compile time, so nothing branches on the board size at run time.
+template<int WIDTH, int HEIGHT, int WIN_LENGTH, int SIZES, int PIECES>
+struct game_config_t {
+	static constexpr int BOARD_WIDTH = WIDTH;
+	static constexpr int BOARD_HEIGHT = HEIGHT;
+	static constexpr int BOARD_TILES = WIDTH * HEIGHT;
+	static constexpr int LINE_LENGTH = WIN_LENGTH;
+	static constexpr int PIECE_SIZES = SIZES;
+	static constexpr int PIECES_PER_SIZE = PIECES;
+	static constexpr int MAX_MOVES = BOARD_TILES * PIECE_SIZES;
+	static constexpr int MAX_PLY = 2 * PIECE_SIZES * PIECES_PER_SIZE + 1;
+	// Rotations only keep the board in place when it is square
+	static constexpr int SYMMETRY_COUNT = WIDTH == HEIGHT ? 8 : 4;
+
+	typedef std::conditional_t<(BOARD_TILES <= 16), uint16_t,
+	        std::conditional_t<(BOARD_TILES <= 32), uint32_t, uint64_t>> tile_mask_t;
+	static constexpr tile_mask_t BOARD_MASK = (tile_mask_t) (BOARD_TILES == 64 ? ~0ull : (1ull << BOARD_TILES) - 1);
+
+	static_assert(BOARD_TILES <= 64, "tile masks are at most one word");
+	static_assert(WIN_LENGTH <= WIDTH || WIN_LENGTH <= HEIGHT, "a line has to fit on the board");
+	static_assert(MAX_PLY <= MAX_GAME_PLY, "too many pieces");
+	static_assert(MAX_MOVES < 255, "moves are packed into a byte");
+};
+
+// Tic-tac-toe with 3 sizes of 2 pieces per player, which can gobble smaller pieces
+typedef game_config_t<3, 3, 3, 3, 2> classic_config_t;
+// 4x4 board with 4 sizes of 3 pieces per player, lines of 4
+typedef game_config_t<4, 4, 4, 4, 3> large_config_t;
+// 7x6 board with 4 sizes of 3 pieces per player, lines of 4. Pieces go on any tile: there
+// is no gravity, so this is not Connect Four
+typedef game_config_t<7, 6, 4, 4, 3> wide_config_t;
+
+// Calls X(config) for every variant the engine is compiled for
+#define FOR_EACH_GAME_CONFIG(X) X(classic_config_t) X(large_config_t) X(wide_config_t)
+
+// The state is packed into as few 64-bit words as it fits in. Its fields are, in order:
+//   visible pieces per player (2 tile masks)
+//   visible pieces per size (PIECE_SIZES tile masks)
+//   remaining pieces per player and size (2 x PIECE_SIZES counters)
+//   player yielded flags
+// A covered piece is removed from the board, so a tile is described by its top piece only.
+// Fields never straddle two words; for the 3x3 game they all fit in one.
+enum state_field_group_t {
+	OWNER_FIELDS,
+	SIZE_FIELDS,
+	REMAINING_FIELDS,
+	YIELDED_FIELDS,
+	FIELD_GROUP_COUNT,
+};
+
+struct state_field_t {
+	int word;
+	int shift;
+};
+
+constexpr int MAX_STATE_WORDS = 8;
+
+template<typename config_t>
+struct state_layout_t {
+	static constexpr int FIELD_COUNT = 2 + config_t::PIECE_SIZES + 2 * config_t::PIECE_SIZES + 2;
+
+	state_field_t fields[FIELD_COUNT];
+	int first[FIELD_GROUP_COUNT]; // index of the group's first field
+	int widths[FIELD_GROUP_COUNT];
+	bool packed[FIELD_GROUP_COUNT]; // all fields of the group follow each other in one word
+	int word_count;
+	uint64_t board_bits[MAX_STATE_WORDS]; // owner and size fields
+	uint64_t remaining_bits[MAX_STATE_WORDS];
+
+	constexpr state_layout_t() : fields(), first(), widths(), packed(), word_count(), board_bits(), remaining_bits() {
+		int remaining_width = 1;
+		while ((1 << remaining_width) <= config_t::PIECES_PER_SIZE) {
+			remaining_width++;
+		}
+		int counts[FIELD_GROUP_COUNT] = {2, config_t::PIECE_SIZES, 2 * config_t::PIECE_SIZES, 2};
+		int group_widths[FIELD_GROUP_COUNT] = {config_t::BOARD_TILES, config_t::BOARD_TILES, remaining_width, 1};
+
+		int word = 0, shift = 0, field = 0;
+		for (int group = 0; group < FIELD_GROUP_COUNT; ++group) {
+			first[group] = field;
+			widths[group] = group_widths[group];
+			packed[group] = true;
+			for (int i = 0; i < counts[group]; ++i) {
+				if (shift + widths[group] > 64) {
+					word++;
+					shift = 0;
+				}
+				fields[field] = {word, shift};
+				packed[group] = packed[group] && word == fields[first[group]].word;
+
+				uint64_t bits = (widths[group] == 64 ? ~0ull : (1ull << widths[group]) - 1) << shift;
+				if (group == OWNER_FIELDS || group == SIZE_FIELDS) {
+					board_bits[word] |= bits;
+				} else if (group == REMAINING_FIELDS) {
+					remaining_bits[word] |= bits;
+				}
+				shift += widths[group];
+				field++;
+			}
+		}
+		word_count = word + 1;
+	}
+};
+
+template<typename config_t>
+constexpr state_layout_t<config_t> state_layout;
+
+// Where field `index` of a group is. The fields of a packed group are found by arithmetic,
+// the others by a table lookup.
+template<typename config_t, state_field_group_t group>
+constexpr state_field_t get_state_field(int index) {
+	constexpr auto const &layout = state_layout<config_t>;
+	constexpr state_field_t first = layout.fields[layout.first[group]];
+	if constexpr (layout.packed[group]) {
+		return {first.word, first.shift + index * layout.widths[group]};
+	} else {
+		return layout.fields[layout.first[group] + index];
+	}
+}
+
+template<typename config_t>
+struct basic_game_state_t {
+	static constexpr int WORDS = state_layout<config_t>.word_count;
+	static_assert(WORDS <= MAX_STATE_WORDS, "state too large");
+
+	uint64_t words[WORDS];
+
+	bool operator==(const basic_game_state_t &other) const {
+		for (int i = 0; i < WORDS; ++i) {
+			if (words[i] != other.words[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// An arbitrary total order, used to pick a canonical state among symmetric ones
+	bool operator<(const basic_game_state_t &other) const {
+		for (int i = WORDS - 1; i >= 0; --i) {
+			if (words[i] != other.words[i]) {
+				return words[i] < other.words[i];
+			}
+		}
+		return false;
+	}
+};
+
+namespace std {
+	template<typename config_t>
+	struct hash<basic_game_state_t<config_t>> {
+		std::size_t operator()(const basic_game_state_t<config_t> &k) const {
+			XXH64_hash_t hash = XXH64(k.words, sizeof(k.words), 1);
+			return hash;
+		}
+	};
+}
+
+
+struct move_t {
+	int player;
+	int size;
+	int position;
+	bool yield;
+};
+
+
+// Every horizontal, vertical and diagonal run of LINE_LENGTH tiles
+template<typename config_t>
+struct victory_masks_t {
+	static constexpr int WIDTH = config_t::BOARD_WIDTH, HEIGHT = config_t::BOARD_HEIGHT;
+	static constexpr int LENGTH = config_t::LINE_LENGTH;
+	static constexpr int DIAGONALS = LENGTH <= WIDTH && LENGTH <= HEIGHT ? (WIDTH - LENGTH + 1) * (HEIGHT - LENGTH + 1) : 0;
+	static constexpr int COUNT = (LENGTH <= WIDTH ? (WIDTH - LENGTH + 1) * HEIGHT : 0) +
+	                             (LENGTH <= HEIGHT ? (HEIGHT - LENGTH + 1) * WIDTH : 0) + 2 * DIAGONALS;
+
+	typename config_t::tile_mask_t masks[COUNT];
+
+	constexpr victory_masks_t() : masks() {
+		int count = 0;
+		for (int y = 0; y < HEIGHT; ++y) {
+			for (int x = 0; x + LENGTH <= WIDTH; ++x) {
+				add_line(count, x, y, 1, 0);
+			}
+		}
+		for (int x = 0; x < WIDTH; ++x) {
+			for (int y = 0; y + LENGTH <= HEIGHT; ++y) {
+				add_line(count, x, y, 0, 1);
+			}
+		}
+		for (int y = 0; y + LENGTH <= HEIGHT; ++y) {
+			for (int x = 0; x + LENGTH <= WIDTH; ++x) {
+				add_line(count, x, y, 1, 1);
+			}
+		}
+		for (int y = LENGTH - 1; y < HEIGHT; ++y) {
+			for (int x = 0; x + LENGTH <= WIDTH; ++x) {
+				add_line(count, x, y, 1, -1);
+			}
+		}
+	}
+
+	constexpr void add_line(int &count, int x, int y, int dx, int dy) {
+		for (int i = 0; i < LENGTH; ++i) {
+			masks[count] |= (typename config_t::tile_mask_t) 1 << ((y + i * dy) * WIDTH + x + i * dx);
+		}
+		count++;
+	}
+};
+
+template<typename config_t>
+constexpr victory_masks_t<config_t> victory_masks_for;
+
+template<typename config_t>
+inline typename config_t::tile_mask_t get_owner_mask(basic_game_state_t<config_t> const &state, int player) {
+	auto field = get_state_field<config_t, OWNER_FIELDS>(player);
+	return (state.words[field.word] >> field.shift) & config_t::BOARD_MASK;
+}
+
+template<typename config_t>
+inline typename config_t::tile_mask_t get_size_mask(basic_game_state_t<config_t> const &state, int size) {
+	auto field = get_state_field<config_t, SIZE_FIELDS>(size);
+	return (state.words[field.word] >> field.shift) & config_t::BOARD_MASK;
+}
+
+template<typename config_t>
+inline state_field_t get_remaining_field(int player, int size) {
+	return get_state_field<config_t, REMAINING_FIELDS>(player * config_t::PIECE_SIZES + size);
+}
+
+template<typename config_t>
+inline int get_remaining_moves(basic_game_state_t<config_t> const &state, int player, int size) {
+	constexpr uint64_t counter_mask = (1ull << state_layout<config_t>.widths[REMAINING_FIELDS]) - 1;
+	auto field = get_remaining_field<config_t>(player, size);
+	return (state.words[field.word] >> field.shift) & counter_mask;
+}
+
+template<typename config_t>
+inline bool has_yielded(basic_game_state_t<config_t> const &state, int player) {
+	auto field = get_state_field<config_t, YIELDED_FIELDS>(player);
+	return (state.words[field.word] >> field.shift) & 1;
+}
+
+template<typename config_t>
+inline void set_yielded(basic_game_state_t<config_t> &state, int player) {
+	auto field = get_state_field<config_t, YIELDED_FIELDS>(player);
+	state.words[field.word] |= 1ull << field.shift;
+}
+
+template<typename config_t>
+inline int get_tile_owner(basic_game_state_t<config_t> const &state, int position) {
+	for (int i = 0; i < 2; ++i) {
+		if ((get_owner_mask(state, i) >> position) & 1) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+template<typename config_t>
+inline int get_tile_size(basic_game_state_t<config_t> const &state, int position) {
+	for (int i = 0; i < config_t::PIECE_SIZES; ++i) {
+		if ((get_size_mask(state, i) >> position) & 1) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Tiles where a piece of the given size may be placed: not already owned by the player,
+// and either empty or topped by a strictly smaller piece.
+template<typename config_t>
+inline typename config_t::tile_mask_t get_move_targets(basic_game_state_t<config_t> const &state, int player, int size) {
+	typename config_t::tile_mask_t blocked = get_owner_mask(state, player);
+	for (int i = size; i < config_t::PIECE_SIZES; ++i) {
+		blocked |= get_size_mask(state, i);
+	}
+	return ~blocked & config_t::BOARD_MASK;
+}
+
+template<typename config_t>
+inline bool is_valid_move(basic_game_state_t<config_t> const &state, move_t const &move) {
+	if (move.position >= 0 && move.position < config_t::BOARD_TILES && move.size >= 0 && move.size < config_t::PIECE_SIZES) {
+		if (get_remaining_moves(state, move.player, move.size) > 0) {
+			return (get_move_targets(state, move.player, move.size) >> move.position) & 1;
+		}
+	}
+
+	return false;
+}
+
+// Puts the piece of a valid, non-yield move on the board, replacing any piece it covers
+template<typename config_t>
+inline void place_piece(basic_game_state_t<config_t> &state, move_t const &move) {
+	constexpr int words = basic_game_state_t<config_t>::WORDS;
+	uint64_t tile = 1ull << move.position;
+	uint64_t clear[words] = {};
+	for (int i = 0; i < 2; ++i) {
+		auto field = get_state_field<config_t, OWNER_FIELDS>(i);
+		clear[field.word] |= tile << field.shift;
+	}
+	for (int i = 0; i < config_t::PIECE_SIZES; ++i) {
+		auto field = get_state_field<config_t, SIZE_FIELDS>(i);
+		clear[field.word] |= tile << field.shift;
+	}
+	for (int i = 0; i < words; ++i) {
+		state.words[i] &= ~clear[i];
+	}
+
+	auto owner = get_state_field<config_t, OWNER_FIELDS>(move.player);
+	auto size = get_state_field<config_t, SIZE_FIELDS>(move.size);
+	auto remaining = get_remaining_field<config_t>(move.player, move.size);
+	state.words[owner.word] |= tile << owner.shift;
+	state.words[size.word] |= tile << size.shift;
+	state.words[remaining.word] -= 1ull << remaining.shift;
+}
+
+template<typename config_t>
+inline std::optional<basic_game_state_t<config_t>> perform_move(basic_game_state_t<config_t> const &state, move_t const &move) {
+	if (move.yield) {
+		basic_game_state_t<config_t> out_state = state;
+		set_yielded(out_state, move.player);
+		return out_state;
+	}
+	if (is_valid_move(state, move)) {
+		basic_game_state_t<config_t> out_state = state;
+		place_piece(out_state, move);
+		return out_state;
+	}
+
+	return std::nullopt;
+}
+
+template<typename config_t>
+inline bool completes_line(typename config_t::tile_mask_t owned) {
+	for (auto mask: victory_masks_for<config_t>.masks) {
+		if ((owned & mask) == mask) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template<typename config_t>
+inline int get_victor(basic_game_state_t<config_t> const &state) {
+	uint64_t remaining = 0;
+	for (int i = 0; i < basic_game_state_t<config_t>::WORDS; ++i) {
+		remaining |= state.words[i] & state_layout<config_t>.remaining_bits[i];
+	}
+	if (remaining == 0) {
+		return 2;
+	}
+
+	for (int i = 0; i < 2; ++i) {
+		if (has_yielded(state, i)) {
+			return 1 - i;
+		}
+	}
+
+	for (int i = 0; i < 2; ++i) {
+		if (completes_line<config_t>(get_owner_mask(state, i))) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+template<typename config_t = classic_config_t>
+inline basic_game_state_t<config_t> get_clear_game_state() {
+	basic_game_state_t<config_t> state = {};
+	for (int i = 0; i < 2; ++i) {
+		for (int j = 0; j < config_t::PIECE_SIZES; ++j) {
+			auto field = get_remaining_field<config_t>(i, j);
+			state.words[field.word] |= (uint64_t) config_t::PIECES_PER_SIZE << field.shift;
+		}
+	}
+
+	return state;
+}
+
+// The rotations and reflections of the board: 8 for a square board, otherwise the two
+// mirror images and the half turn. tiles[k][i] is where tile i ends up under transform k,
+// and transform_mask applies the same permutation to a whole tile mask, a chunk of tiles
+// at a time through the masks tables (one chunk for boards of up to 12 tiles).
+template<typename config_t>
+struct symmetry_tables_t {
+	typedef typename config_t::tile_mask_t tile_mask_t;
+	static constexpr int COUNT = config_t::SYMMETRY_COUNT;
+	static constexpr int TILES = config_t::BOARD_TILES;
+	static constexpr int CHUNK_BITS = TILES <= 12 ? TILES : 8;
+	static constexpr int CHUNK_COUNT = (TILES + CHUNK_BITS - 1) / CHUNK_BITS;
+
+	int8_t tiles[COUNT][TILES];
+	int8_t inverse[COUNT];
+	tile_mask_t masks[COUNT][CHUNK_COUNT][1 << CHUNK_BITS];
+
+	constexpr symmetry_tables_t() : tiles(), inverse(), masks() {
+		constexpr int width = config_t::BOARD_WIDTH, height = config_t::BOARD_HEIGHT;
+		constexpr int last_x = width - 1, last_y = height - 1;
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				// Transforms that swap x and y only exist for square boards, where last_x == last_y
+				int coordinates[8][2] = {
+						{x,          y},
+						{last_y - y, x},
+						{last_x - x, last_y - y},
+						{y,          last_x - x},
+						{last_x - x, y},
+						{x,          last_y - y},
+						{y,          x},
+						{last_y - y, last_x - x},
+				};
+				constexpr int rectangular[4] = {0, 2, 4, 5};
+				for (int k = 0; k < COUNT; ++k) {
+					auto const &c = coordinates[COUNT == 8 ? k : rectangular[k]];
+					tiles[k][y * width + x] = (int8_t) (c[1] * width + c[0]);
+				}
+			}
+		}
+
+		for (int k = 0; k < COUNT; ++k) {
+			for (int j = 0; j < COUNT; ++j) {
+				bool is_inverse = true;
+				for (int i = 0; i < TILES; ++i) {
+					if (tiles[j][tiles[k][i]] != i) {
+						is_inverse = false;
+					}
+				}
+				if (is_inverse) {
+					inverse[k] = (int8_t) j;
+				}
+			}
+
+			for (int chunk = 0; chunk < CHUNK_COUNT; ++chunk) {
+				for (int mask = 0; mask < (1 << CHUNK_BITS); ++mask) {
+					for (int bit = 0; bit < CHUNK_BITS && chunk * CHUNK_BITS + bit < TILES; ++bit) {
+						if (mask & (1 << bit)) {
+							masks[k][chunk][mask] |= (tile_mask_t) 1 << tiles[k][chunk * CHUNK_BITS + bit];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	tile_mask_t transform_mask(tile_mask_t mask, int symmetry) const {
+		auto const &chunks = masks[symmetry];
+		if constexpr (CHUNK_COUNT == 1) {
+			return chunks[0][mask];
+		} else {
+			tile_mask_t out_mask = 0;
+			for (int chunk = 0; chunk < CHUNK_COUNT; ++chunk) {
+				out_mask |= chunks[chunk][(mask >> (chunk * CHUNK_BITS)) & ((1 << CHUNK_BITS) - 1)];
+			}
+			return out_mask;
+		}
+	}
+};
+
+template<typename config_t>
+constexpr symmetry_tables_t<config_t> symmetry_tables_for;
+
+template<typename config_t>
+inline basic_game_state_t<config_t> transform_state(basic_game_state_t<config_t> const &state, int symmetry) {
+	auto const &tables = symmetry_tables_for<config_t>;
+	basic_game_state_t<config_t> out_state;
+	for (int i = 0; i < basic_game_state_t<config_t>::WORDS; ++i) {
+		out_state.words[i] = state.words[i] & ~state_layout<config_t>.board_bits[i];
+	}
+	for (int i = 0; i < 2; ++i) {
+		auto field = get_state_field<config_t, OWNER_FIELDS>(i);
+		out_state.words[field.word] |= (uint64_t) tables.transform_mask(get_owner_mask(state, i), symmetry) << field.shift;
+	}
+	for (int i = 0; i < config_t::PIECE_SIZES; ++i) {
+		auto field = get_state_field<config_t, SIZE_FIELDS>(i);
+		out_state.words[field.word] |= (uint64_t) tables.transform_mask(get_size_mask(state, i), symmetry) << field.shift;
+	}
+	return out_state;
+}
+
+template<typename config_t = classic_config_t>
+inline move_t transform_move(move_t move, int symmetry) {
+	if (!move.yield) {
+		move.position = symmetry_tables_for<config_t>.tiles[symmetry][move.position];
+	}
+	return move;
+}
+
+template<typename config_t>
+struct basic_canonical_state_t {
+	basic_game_state_t<config_t> state;
+	int symmetry; // transform_state(original, symmetry) == state
+};
+
+// The representative of a position's symmetry class is the lowest of its transforms.
+// Moves found for the canonical state map back with the inverse of its symmetry.
+template<typename config_t>
+inline basic_canonical_state_t<config_t> get_canonical_state(basic_game_state_t<config_t> const &state) {
+	basic_canonical_state_t<config_t> canonical = {state, 0};
+	for (int k = 1; k < config_t::SYMMETRY_COUNT; ++k) {
+		basic_game_state_t<config_t> transformed = transform_state(state, k);
+		if (transformed < canonical.state) {
+			canonical = {transformed, k};
+		}
+	}
+	return canonical;
+}
+
+// Fixed-capacity move list, so that generating moves never touches the heap
+template<typename config_t>
+struct basic_move_list_t {
+	move_t moves[config_t::MAX_MOVES];
+	int count = 0;
+
+	void push(move_t const &move) {
+		moves[count++] = move;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	move_t *begin() {
+		return moves;
+	}
+
+	move_t *end() {
+		return moves + count;
+	}
+
+	move_t const *begin() const {
+		return moves;
+	}
+
+	move_t const *end() const {
+		return moves + count;
+	}
+
+	move_t &operator[](int index) {
+		return moves[index];
+	}
+
+	move_t const &operator[](int index) const {
+		return moves[index];
+	}
+};
+
+// With skip_symmetric set, a move is left out when a symmetry of the position maps it onto
+// a move at a lower position, so only one move of each equivalent group is returned.
+template<typename config_t>
+inline void generate_moves(basic_game_state_t<config_t> const &state, int player, basic_move_list_t<config_t> &out_moves,
+                           bool skip_symmetric = false) {
+	typedef typename config_t::tile_mask_t tile_mask_t;
+	tile_mask_t duplicates = 0;
+	if (skip_symmetric) {
+		for (int k = 1; k < config_t::SYMMETRY_COUNT; ++k) {
+			if (!(transform_state(state, k) == state)) continue;
+
+			for (int i = 0; i < config_t::BOARD_TILES; ++i) {
+				if (symmetry_tables_for<config_t>.tiles[k][i] < i) {
+					duplicates |= (tile_mask_t) 1 << i;
+				}
+			}
+		}
+	}
+
+	out_moves.count = 0;
+	for (int j = 0; j < config_t::PIECE_SIZES; ++j) {
+		if (get_remaining_moves(state, player, j) == 0) continue;
+
+		tile_mask_t targets = get_move_targets(state, player, j) & ~duplicates;
+		while (targets) {
+			move_t move;
+			move.yield = false;
+			move.player = player;
+			move.position = __builtin_ctzll(targets);
+			move.size = j;
+			out_moves.push(move);
+			targets &= targets - 1;
+		}
+	}
+}
+
+template<typename config_t>
+inline std::vector<move_t> get_valid_moves(basic_game_state_t<config_t> const &state, int player, bool skip_symmetric = false) {
+	basic_move_list_t<config_t> moves;
+	generate_moves(state, player, moves, skip_symmetric);
+	return std::vector<move_t>(moves.begin(), moves.end());
+}
+
+template<typename config_t>
+inline int get_remaining_plies(basic_game_state_t<config_t> const &state) {
+	int total = 0;
+	for (int i = 0; i < 2; ++i) {
+		for (int j = 0; j < config_t::PIECE_SIZES; ++j) {
+			total += get_remaining_moves(state, i, j);
+		}
+	}
+	return total;
+}
+
+// Zobrist keys. The piece keys are laid out per symmetry: pieces[k][tile] is the key of the
+// tile that `tile` maps to under transform k, so that hashing with pieces[k] gives the hash
+// of transform_state(state, k) without transforming the state.
+template<typename config_t>
+struct zobrist_keys_t {
+	static constexpr int SYMMETRIES = config_t::SYMMETRY_COUNT, TILES = config_t::BOARD_TILES;
+	static constexpr int SIZES = config_t::PIECE_SIZES;
+
+	uint64_t pieces[SYMMETRIES][TILES][2][SIZES];
+	uint64_t remaining[2][SIZES][config_t::PIECES_PER_SIZE + 1];
+	uint64_t yielded[2];
+	uint64_t player_to_move;
+
+	constexpr zobrist_keys_t() : pieces(), remaining(), yielded(), player_to_move() {
+		uint64_t seed = 0x746963746163746full;
+		uint64_t base[TILES][2][SIZES] = {};
+		for (auto &tile: base) {
+			for (auto &player: tile) {
+				for (auto &key: player) {
+					key = splitmix64(seed);
+				}
+			}
+		}
+		for (int k = 0; k < SYMMETRIES; ++k) {
+			for (int i = 0; i < TILES; ++i) {
+				for (int p = 0; p < 2; ++p) {
+					for (int j = 0; j < SIZES; ++j) {
+						pieces[k][i][p][j] = base[symmetry_tables_for<config_t>.tiles[k][i]][p][j];
+					}
+				}
+			}
+		}
+		for (auto &player: remaining) {
+			for (auto &size: player) {
+				for (auto &key: size) {
+					key = splitmix64(seed);
+				}
+			}
+		}
+		for (auto &key: yielded) {
+			key = splitmix64(seed);
+		}
+		player_to_move = splitmix64(seed);
+	}
+};
+
+template<typename config_t>
+constexpr zobrist_keys_t<config_t> zobrist_keys_for;
+
+// A state together with its Zobrist hash under each board symmetry, kept up to date
+// incrementally by make_move and unmake_move.
+template<typename config_t>
+struct basic_position_t {
+	basic_game_state_t<config_t> state;
+	uint64_t hashes[config_t::SYMMETRY_COUNT];
+};
+
+template<typename config_t>
+inline basic_position_t<config_t> get_position(basic_game_state_t<config_t> const &state) {
+	auto const &keys = zobrist_keys_for<config_t>;
+	basic_position_t<config_t> position = {state, {}};
+	for (int k = 0; k < config_t::SYMMETRY_COUNT; ++k) {
+		uint64_t hash = 0;
+		for (int i = 0; i < config_t::BOARD_TILES; ++i) {
+			int owner = get_tile_owner(state, i);
+			if (owner != -1) {
+				hash ^= keys.pieces[k][i][owner][get_tile_size(state, i)];
+			}
+		}
+		for (int p = 0; p < 2; ++p) {
+			for (int j = 0; j < config_t::PIECE_SIZES; ++j) {
+				hash ^= keys.remaining[p][j][get_remaining_moves(state, p, j)];
+			}
+			if (has_yielded(state, p)) {
+				hash ^= keys.yielded[p];
+			}
+		}
+		position.hashes[k] = hash;
+	}
+	return position;
+}
+
+// Toggles the keys a move changes, given the state before the move. Applying it twice
+// leaves the hashes unchanged, which is what unmake_move relies on.
+template<typename config_t>
+inline void toggle_move_hashes(basic_position_t<config_t> &position, basic_game_state_t<config_t> const &before,
+                               move_t const &move) {
+	auto const &zobrist_keys = zobrist_keys_for<config_t>;
+	if (move.yield) {
+		for (auto &hash: position.hashes) {
+			hash ^= zobrist_keys.yielded[move.player];
+		}
+		return;
+	}
+
+	int remaining = get_remaining_moves(before, move.player, move.size);
+	uint64_t counter_keys = zobrist_keys.remaining[move.player][move.size][remaining] ^
+	                        zobrist_keys.remaining[move.player][move.size][remaining - 1];
+	int covered_size = -1;
+	if ((get_owner_mask(before, 1 - move.player) >> move.position) & 1) {
+		covered_size = get_tile_size(before, move.position);
+	}
+
+	for (int k = 0; k < config_t::SYMMETRY_COUNT; ++k) {
+		auto const &tile_keys = zobrist_keys.pieces[k][move.position];
+		uint64_t keys = counter_keys ^ tile_keys[move.player][move.size];
+		if (covered_size != -1) {
+			keys ^= tile_keys[1 - move.player][covered_size];
+		}
+		position.hashes[k] ^= keys;
+	}
+}
+
+template<typename config_t>
+struct basic_undo_t {
+	basic_game_state_t<config_t> state;
+};
+
+// Applies a valid move in place; unmake_move with the same undo record reverts it
+template<typename config_t>
+inline void make_move(basic_position_t<config_t> &position, move_t const &move, basic_undo_t<config_t> &out_undo) {
+	out_undo.state = position.state;
+	toggle_move_hashes(position, position.state, move);
+	if (move.yield) {
+		set_yielded(position.state, move.player);
+	} else {
+		place_piece(position.state, move);
+	}
+}
+
+template<typename config_t>
+inline void unmake_move(basic_position_t<config_t> &position, move_t const &move, basic_undo_t<config_t> const &undo) {
+	position.state = undo.state;
+	toggle_move_hashes(position, position.state, move);
+}
+
+struct canonical_hash_t {
+	uint64_t hash;
+	int symmetry; // the hash is that of transform_state(state, symmetry)
+};
+
+// Symmetric positions have the same set of per-symmetry hashes, so the lowest one
+// identifies the whole symmetry class.
+template<typename config_t>
+inline canonical_hash_t get_canonical_hash(basic_position_t<config_t> const &position) {
+	canonical_hash_t canonical = {position.hashes[0], 0};
+	for (int k = 1; k < config_t::SYMMETRY_COUNT; ++k) {
+		if (position.hashes[k] < canonical.hash) {
+			canonical = {position.hashes[k], k};
+		}
+	}
+	return canonical;
+}
+
+// The 3x3 game, for the parts of the engine that only play it (tablebase, MCTS playouts)
+typedef basic_game_state_t<classic_config_t> game_state_t;
+typedef basic_canonical_state_t<classic_config_t> canonical_state_t;
+typedef basic_move_list_t<classic_config_t> move_list_t;
+typedef basic_position_t<classic_config_t> position_t;
+typedef basic_undo_t<classic_config_t> undo_t;
+typedef classic_config_t::tile_mask_t tile_mask_t;
+
+constexpr int BOARD_WIDTH = classic_config_t::BOARD_WIDTH;
+constexpr int BOARD_TILES = classic_config_t::BOARD_TILES;
+constexpr int PIECE_SIZES = classic_config_t::PIECE_SIZES;
+constexpr int PIECES_PER_SIZE = classic_config_t::PIECES_PER_SIZE;
+constexpr int MAX_MOVES = classic_config_t::MAX_MOVES;
+constexpr int MAX_PLY = classic_config_t::MAX_PLY;
+constexpr int SYMMETRY_COUNT = classic_config_t::SYMMETRY_COUNT;
+constexpr tile_mask_t BOARD_MASK = classic_config_t::BOARD_MASK;
+
+inline constexpr auto const &victory_masks = victory_masks_for<classic_config_t>;
+inline constexpr auto const &symmetry_tables = symmetry_tables_for<classic_config_t>;
+inline constexpr auto const &zobrist_keys = zobrist_keys_for<classic_config_t>;
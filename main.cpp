@@ -1,169 +1,21 @@
-#include <xxhash.h>
+#include "mcts.h"
+#include "rng.h"
+#include "search.h"
+#include "selfplay.h"
+#include "tablebase.h"
+
 #include <array>
 #include <functional>
 #include <cstdio>
-#include <vector>
-#include <optional>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <unordered_map>
-
-struct board_tile_t {
-	int8_t owner;
-	int8_t size;
-};
-
-struct game_state_t {
-	board_tile_t board[9];
-	int remaining_moves[2][3];
-	bool player_yielded[2];
-
-	bool operator==(const game_state_t &other) const {
-		return memcmp((int8_t *) this, (int8_t *) &other, sizeof(game_state_t)) == 0;
-	}
-};
-
-namespace std {
-	template<>
-	struct hash<game_state_t> {
-		std::size_t operator()(const game_state_t &k) const {
-			int8_t *data = (int8_t *) &k;
-
-			XXH64_hash_t hash = XXH64(data, sizeof(game_state_t), 1);
-			return hash;
-		}
-	};
-}
-
-
-struct move_t {
-	int player;
-	int size;
-	int position;
-	bool yield;
-};
-
-
-bool is_valid_move(game_state_t const &state, move_t const &move) {
-	if (state.remaining_moves[move.player][move.size] > 0) {
-		if (move.position >= 0 && move.position < 9 && move.size >= 0 && move.size < 3) {
-			if (state.board[move.position].owner != move.player && state.board[move.position].size < move.size) {
-				return true;
-			}
-		}
-	}
-
-	return false;
-}
-
-std::optional<game_state_t> perform_move(game_state_t const &state, move_t const &move) {
-	if (move.yield) {
-		game_state_t out_state = state;
-		out_state.player_yielded[move.player] = true;
-		return out_state;
-	}
-	if (is_valid_move(state, move)) {
-		game_state_t out_state = state;
-		out_state.board[move.position].owner = move.player;
-		out_state.board[move.position].size = move.size;
-		out_state.remaining_moves[move.player][move.size]--;
-		return out_state;
-	}
-
-	return std::nullopt;
-}
-
-int get_victor(game_state_t const &state) {
-	int victory_conditions[][3] = {
-			{0, 1, 2},
-			{3, 4, 5},
-			{6, 7, 8},
-
-			{0, 3, 6},
-			{1, 4, 7},
-			{2, 5, 8},
-
-			{0, 4, 8},
-			{6, 4, 2},
-	};
-
-	bool out_of_moves = true;
-	for (int i = 0; i < 2; ++i) {
-		for (int j = 0; j < 3; ++j) {
-			if (state.remaining_moves[i][j] > 0) {
-				out_of_moves = false;
-			}
-		}
-	}
-	if (out_of_moves) {
-		return 2;
-	}
-
-	for (int i = 0; i < 2; ++i) {
-		if (state.player_yielded[i]) {
-			return 1 - i;
-		}
-	}
-
-	for (auto condition: victory_conditions) {
-		int owner = -1;
-		bool victory = true;
-
-		owner = state.board[condition[0]].owner;
-		if (owner == -1) continue;
-		for (int i = 0; i < 3; ++i) {
-			if (state.board[condition[i]].owner != owner) {
-				victory = false;
-				break;
-			}
-		}
-
-		if (victory) {
-			return owner;
-		}
-	}
-
-	return -1;
-}
+#include <type_traits>
 
-game_state_t get_clear_game_state() {
-	game_state_t state;
-	for (int i = 0; i < 9; ++i) {
-		state.board[i].owner = -1;
-		state.board[i].size = -1;
-	}
-
-	for (int i = 0; i < 2; ++i) {
-		for (int j = 0; j < 3; ++j) {
-			state.remaining_moves[i][j] = 2;
-		}
-	}
-
-	state.player_yielded[0] = false;
-	state.player_yielded[1] = false;
-
-	return state;
-}
-
-std::vector<move_t> get_valid_moves(game_state_t const &state, int player) {
-	std::vector<move_t> moves;
-	for (int i = 0; i < 9; i++) {
-		for (int j = 0; j < 3; ++j) {
-			move_t move;
-			move.yield = false;
-			move.player = player;
-			move.position = i;
-			move.size = j;
-			if (is_valid_move(state, move)) {
-				moves.emplace_back(move);
-			}
-		}
-	}
-
-	return moves;
-}
-
-move_t get_move_player(game_state_t const &state, int player) {
-	printf("Enter move in format X Y Z (X, Y, and Size, in numbers from 1 to 3\n");
+template<typename config_t>
+move_t get_move_player(basic_game_state_t<config_t> const &state, int player) {
+	printf("Enter move in format X Y Z (X from 1 to %i, Y from 1 to %i and Size from 1 to %i)\n",
+	       config_t::BOARD_WIDTH, config_t::BOARD_HEIGHT, config_t::PIECE_SIZES);
 
 	char x_str[256], y_str[256], z_str[256];
 	scanf("%s %s %s", x_str, y_str, z_str);
@@ -171,45 +23,50 @@ move_t get_move_player(game_state_t const &state, int player) {
 	int y = atoi(y_str) - 1;
 	int z = atoi(z_str) - 1;
 
-	int pos = y * 3 + x;
+	int pos = y * config_t::BOARD_WIDTH + x;
 
 	return {player, z, pos, false};
 }
 
-move_t get_move_random_ai(game_state_t const &state, int player) {
-	auto moves = get_valid_moves(state, player);
-//    printf("Valid moves: %i\n", (int) moves.size());
+template<typename config_t>
+move_t get_move_random_ai(basic_game_state_t<config_t> const &state, int player) {
+	basic_move_list_t<config_t> moves;
+	generate_moves(state, player, moves);
+//    printf("Valid moves: %i\n", (int) moves.count);
 	if (moves.empty()) {
 		return {player, -1, -1, true};
 	}
-	return moves[rand() % moves.size()];
+	return moves[get_thread_rng().next_below((uint32_t) moves.count)];
 }
 
-void play_game(std::array<std::function<move_t(game_state_t const &, int)>, 2> brains) {
-	char size_array[] = {'.', 'x', 'X'};
-	game_state_t state = get_clear_game_state();
+template<typename config_t>
+void play_game(std::array<basic_brain_t<config_t>, 2> brains) {
+	static_assert(config_t::PIECE_SIZES <= 4, "no symbols for more sizes");
+	char const *size_array = config_t::PIECE_SIZES == 3 ? ".xX" : ".oxX";
+	auto state = get_clear_game_state<config_t>();
 	bool running = true;
 	while (running) {
 		for (int player = 0; player < brains.size(); ++player) {
 			printf("-----------------\n");
 			printf("Player 1: ");
-			for (int i = 0; i < 3; ++i) {
-				for (int j = 0; j < state.remaining_moves[0][i]; ++j) {
+			for (int i = 0; i < config_t::PIECE_SIZES; ++i) {
+				for (int j = 0; j < get_remaining_moves(state, 0, i); ++j) {
 					printf("%c", size_array[i]);
 				}
 			}
 			printf("\nPlayer 2: ");
-			for (int i = 0; i < 3; ++i) {
-				for (int j = 0; j < state.remaining_moves[1][i]; ++j) {
+			for (int i = 0; i < config_t::PIECE_SIZES; ++i) {
+				for (int j = 0; j < get_remaining_moves(state, 1, i); ++j) {
 					printf("%c", size_array[i]);
 				}
 			}
 			printf("\n");
 			printf("\n");
 
-			for (int y = 0; y < 3; ++y) {
-				for (int x = 0; x < 3; ++x) {
-					printf("%c|%c\t", state.board[y * 3 + x].owner + '1', state.board[y * 3 + x].size + '1');
+			for (int y = 0; y < config_t::BOARD_HEIGHT; ++y) {
+				for (int x = 0; x < config_t::BOARD_WIDTH; ++x) {
+					int tile = y * config_t::BOARD_WIDTH + x;
+					printf("%c|%c\t", get_tile_owner(state, tile) + '1', get_tile_size(state, tile) + '1');
 				}
 				printf("\n");
 			}
@@ -228,7 +85,7 @@ void play_game(std::array<std::function<move_t(game_state_t const &, int)>, 2> b
 			printf("-----------------\n\n\n");
 
 
-			std::optional<game_state_t> result;
+			std::optional<basic_game_state_t<config_t>> result;
 			do {
 				move_t move = brains[player](state, player);
 				result = perform_move(state, move);
@@ -238,81 +95,161 @@ void play_game(std::array<std::function<move_t(game_state_t const &, int)>, 2> b
 	}
 }
 
-int get_score_for_moves_left(game_state_t const &state, int player) {
-	int total = 0;
-	for (int i = 0; i < 3; ++i) {
-		total += state.remaining_moves[player][i] * (i * 5);
-	}
-
-	return total;
-}
-
-int get_score(game_state_t const &state, int player) {
-	int victory = get_victor(state);
-	if (victory == -1) {
-		return get_score_for_moves_left(state, player);
+// Self-play games are many and short, so the search brain gets a small cache per worker and
+// a fixed depth rather than a time budget, which keeps the results reproducible.
+constexpr size_t SELFPLAY_CACHE_MB = 1;
+constexpr int SELFPLAY_DEPTH = 4;
+
+template<typename config_t>
+bool get_selfplay_brain(char const *name, search_options_t const &options, size_t cache_megabytes,
+                        basic_brain_factory_t<config_t> &out_brain) {
+	if (strcmp(name, "smart") == 0) {
+		out_brain = make_search_brain<config_t>(options, cache_megabytes);
+	} else if (strcmp(name, "mcts") == 0) {
+		if constexpr (std::is_same<config_t, classic_config_t>::value) {
+			out_brain = make_mcts_brain(mcts_options);
+		} else {
+			printf("MCTS only plays the classic variant\n");
+			return false;
+		}
+	} else if (strcmp(name, "random") == 0) {
+		out_brain = make_stateless_brain<config_t>(get_move_random_ai<config_t>);
+	} else {
+		printf("Unknown brain %s, expected smart, mcts or random\n", name);
+		return false;
 	}
-	if (victory == player)
-		return INT32_MAX;
-	if (victory == 1 - player)
-		return INT32_MIN;
-
-	return 0;
+	return true;
 }
 
-std::unordered_map<game_state_t, std::pair<move_t, int>> cache;
-
-std::pair<move_t, int> maximize(game_state_t const &state, int player, int depth_left) {
-	auto ret = cache.find(state);
-	if ( ret != cache.end()) {
-		return ret->second;
-	}
-
-	auto moves = get_valid_moves(state, player);
-	std::pair<move_t, int> best_result = {{}, INT32_MIN};
-	for (auto const &move: moves) {
-		auto new_state = perform_move(state, move);
-
-		int state_score = get_score(*new_state, player);
-		if (state_score == INT32_MAX) {
-			return {move, state_score};
-		}
+// Command line options that apply to every variant
+struct run_options_t {
+	selfplay_options_t selfplay_options;
+	bool selfplay = false;
+	char players[256] = "smart,random";
+	size_t hash_megabytes = 0;
+	bool time_set = false, depth_set = false;
+	bool mcts_engine = false;
+};
 
-		if (state_score == -INT32_MIN) {
-			return {move, state_score};
+template<typename config_t>
+int run(run_options_t &run_options) {
+	if (run_options.selfplay) {
+		search_options_t options = search_options;
+		if (!run_options.time_set) options.time_budget_ms = 0;
+		if (!run_options.depth_set) options.max_depth = SELFPLAY_DEPTH;
+
+		char *players = run_options.players;
+		char *separator = strchr(players, ',');
+		if (!separator) {
+			printf("Expected two comma separated brains, got %s\n", players);
+			return 1;
 		}
-
-		if (depth_left <= 0) {
-			return {move, state_score};
+		*separator = '\0';
+		char const *names[2] = {players, separator + 1};
+		size_t cache_megabytes = run_options.hash_megabytes ? run_options.hash_megabytes : SELFPLAY_CACHE_MB;
+		std::array<basic_brain_factory_t<config_t>, 2> brains;
+		for (int i = 0; i < 2; ++i) {
+			if (!get_selfplay_brain<config_t>(names[i], options, cache_megabytes, brains[i])) {
+				return 1;
+			}
 		}
 
+		print_selfplay_result(run_selfplay(brains, run_options.selfplay_options), names);
+		return 0;
+	}
 
-		auto res = maximize(*new_state, 1 - player, depth_left - 1);
-		int others_score = -res.second / 2;
-		if (others_score > best_result.second) {
-			best_result.first = move;
-			best_result.second = others_score;
+	basic_brain_t<config_t> engine = smarter_ai<config_t>;
+	if (run_options.mcts_engine) {
+		if constexpr (std::is_same<config_t, classic_config_t>::value) {
+			engine = mcts_ai;
+		} else {
+			printf("MCTS only plays the classic variant\n");
+			return 1;
 		}
 	}
-
-	cache.insert_or_assign(state, best_result);
-	return best_result;
-}
-
-move_t smarter_ai(game_state_t const &state, int player) {
-	cache.clear();
-	return maximize(state, player, 7).first;
-}
-
-int main() {
-	srand((unsigned int) std::time(nullptr));
-
-	play_game({smarter_ai, get_move_player});
+	play_game<config_t>({engine, get_move_player<config_t>});
 	return 0;
 }
 
+int main(int argc, char **argv) {
+	get_thread_rng().reseed((uint64_t) std::time(nullptr));
+
+	run_options_t run_options;
+	selfplay_options_t &selfplay_options = run_options.selfplay_options;
+	char const *variant = "classic";
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc) {
+			run_options.hash_megabytes = strtoul(argv[++i], nullptr, 10);
+			cache.resize(run_options.hash_megabytes);
+		} else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+			search_options.time_budget_ms = atoi(argv[++i]);
+			run_options.time_set = true;
+		} else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+			search_options.max_depth = atoi(argv[++i]);
+			run_options.depth_set = true;
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			search_options.threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--tablebase") == 0 && i + 1 < argc) {
+			if (!load_tablebase(tablebase, argv[++i])) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--selfplay") == 0 && i + 1 < argc) {
+			run_options.selfplay = true;
+			selfplay_options.games = strtoull(argv[++i], nullptr, 10);
+		} else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+			snprintf(run_options.players, sizeof(run_options.players), "%s", argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			selfplay_options.seed = strtoull(argv[++i], nullptr, 10);
+		} else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+			selfplay_options.threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+			char const *name = argv[++i];
+			if (strcmp(name, "mcts") == 0) {
+				run_options.mcts_engine = true;
+			} else if (strcmp(name, "smart") != 0) {
+				printf("Unknown engine %s, expected smart or mcts\n", name);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+			variant = argv[++i];
+		} else if (strcmp(argv[i], "--playouts") == 0 && i + 1 < argc) {
+			mcts_options.playouts = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--mcts-time") == 0 && i + 1 < argc) {
+			mcts_options.time_budget_ms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--reuse-tree") == 0) {
+			mcts_options.reuse_tree = true;
+		} else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+#ifdef TICTACTOE_SEARCH_STATS
+			char const *path = argv[++i];
+			search_options.stats_output = strcmp(path, "-") == 0 ? stdout : fopen(path, "a");
+			if (!search_options.stats_output) {
+				printf("Could not open %s\n", path);
+				return 1;
+			}
+#else
+			printf("Search statistics are not compiled in, configure with -DTICTACTOE_SEARCH_STATS=ON\n");
+			return 1;
+#endif
+		} else {
+			printf("Usage: %s [--variant <classic|4x4|7x6>] [--hash <megabytes>] [--time <milliseconds>]"
+			       " [--depth <plies>] [--threads <count>] [--tablebase <file>] [--stats <file>]\n"
+			       "       [--engine <smart|mcts>] [--playouts <count>] [--mcts-time <milliseconds>] [--reuse-tree]\n"
+			       "       %s --selfplay <games> [--players <brain>,<brain>] [--seed <seed>] [--workers <count>]"
+			       " [search and MCTS options]\n"
+			       "Variants: classic (3x3), 4x4 and 7x6, both with lines of 4; pieces go on any tile, without gravity\n"
+			       "Brains: smart, mcts (classic only), random\n", argv[0], argv[0]);
+			return 1;
+		}
+	}
 
-
-
-
-
+	if (strcmp(variant, "classic") == 0) {
+		return run<classic_config_t>(run_options);
+	} else if (strcmp(variant, "4x4") == 0) {
+		return run<large_config_t>(run_options);
+	} else if (strcmp(variant, "7x6") == 0) {
+		return run<wide_config_t>(run_options);
+	}
+	printf("Unknown variant %s, expected classic, 4x4 or 7x6\n", variant);
+	return 1;
+}
@@ -0,0 +1,173 @@
+#include "mcts.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+mcts_options_t mcts_options;
+
+mcts_t::mcts_t(mcts_options_t const &options, uint64_t seed) : options(options) {
+	this->seed(seed);
+}
+
+void mcts_t::seed(uint64_t seed) {
+	rng.seed(seed);
+}
+
+void mcts_t::clear() {
+	nodes.clear();
+}
+
+void mcts_t::set_root(game_state_t const &state, int player) {
+	// After our move and the reply, the position is one of the grandchildren of the old root,
+	// or still the root when asked for the same position again
+	if (options.reuse_tree && !nodes.empty() && player == root_player) {
+		mcts_node_t const &root = nodes[0];
+		if (root.state == state) {
+			return;
+		}
+		for (uint32_t i = 0; i < root.child_count; ++i) {
+			mcts_node_t const &child = nodes[root.first_child + i];
+			for (uint32_t j = 0; j < child.child_count; ++j) {
+				uint32_t index = child.first_child + j;
+				if (nodes[index].state == state) {
+					// Copy the subtree breadth first, which keeps every node's children together
+					std::vector<mcts_node_t> kept = {nodes[index]};
+					for (size_t k = 0; k < kept.size(); ++k) {
+						uint32_t first = kept[k].first_child, count = kept[k].child_count;
+						kept[k].first_child = (uint32_t) kept.size();
+						for (uint32_t c = 0; c < count; ++c) {
+							kept.push_back(nodes[first + c]);
+						}
+					}
+					nodes.swap(kept);
+					return;
+				}
+			}
+		}
+	}
+
+	nodes.clear();
+	nodes.push_back({state, 0, 0, 0, 0, 0, (int8_t) get_victor(state), false});
+	root_player = player;
+}
+
+void mcts_t::expand(uint32_t index, int player) {
+	game_state_t state = nodes[index].state;
+	move_list_t moves;
+	generate_moves(state, player, moves);
+	if (moves.empty()) {
+		moves.push({player, -1, -1, true});
+	}
+
+	uint32_t first = (uint32_t) nodes.size();
+	for (auto const &move: moves) {
+		game_state_t child = *perform_move(state, move);
+		nodes.push_back({child, 0, 0, 0, 0, pack_move(move), (int8_t) get_victor(child), false});
+	}
+	nodes[index].first_child = first;
+	nodes[index].child_count = (uint8_t) moves.count;
+	nodes[index].expanded = true;
+}
+
+// UCT: the mean result plus an exploration bonus that shrinks as a child gets visited.
+// Unvisited children come first, in move order.
+uint32_t mcts_t::select_child(mcts_node_t const &node) const {
+	double log_visits = std::log((double) node.visits);
+	uint32_t best = node.first_child;
+	double best_value = -1;
+	for (uint32_t i = node.first_child; i < node.first_child + node.child_count; ++i) {
+		mcts_node_t const &child = nodes[i];
+		if (child.visits == 0) {
+			return i;
+		}
+		double value = child.score / (2.0 * child.visits) + options.exploration * std::sqrt(log_visits / child.visits);
+		if (value > best_value) {
+			best_value = value;
+			best = i;
+		}
+	}
+	return best;
+}
+
+// Sum of the results of `count` games from the node for the player to move there
+uint64_t mcts_t::evaluate(mcts_node_t const &node, int player, int count) {
+	if (node.victor != -1) {
+		int result = node.victor == 2 ? 1 : node.victor == player ? 2 : 0;
+		return (uint64_t) result * count;
+	}
+	return run_rollouts(rng, node.state, player, count / rollout_lanes_t::COUNT);
+}
+
+move_t mcts_t::get_move(game_state_t const &state, int player) {
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::milliseconds(options.time_budget_ms);
+	int leaf_playouts = std::max(options.leaf_playouts, 1);
+	// Without either budget the search would never end
+	int playout_budget = options.playouts;
+	if (playout_budget <= 0 && options.time_budget_ms <= 0) {
+		playout_budget = mcts_options_t().playouts;
+	}
+	leaf_playouts = (leaf_playouts + rollout_lanes_t::COUNT - 1) / rollout_lanes_t::COUNT * rollout_lanes_t::COUNT;
+
+	set_root(state, player);
+	if (!nodes[0].expanded) {
+		expand(0, player);
+	}
+	if (nodes[0].child_count == 1) {
+		return unpack_move(nodes[nodes[0].first_child].move, player);
+	}
+
+	playouts = nodes[0].visits;
+	uint32_t path[MAX_PLY + 2];
+	for (uint64_t iteration = 0;; ++iteration) {
+		if (playout_budget > 0 && playouts >= (uint64_t) playout_budget) {
+			break;
+		}
+		if (options.time_budget_ms > 0 && iteration % 16 == 0 && std::chrono::steady_clock::now() >= deadline) {
+			break;
+		}
+
+		// Walk down to a leaf, expanding it when it has been played out before
+		int depth = 0;
+		int to_move = player;
+		path[depth++] = 0;
+		uint32_t index = 0;
+		while (nodes[index].victor == -1) {
+			if (!nodes[index].expanded) {
+				if (nodes[index].visits == 0 || nodes.size() >= options.max_nodes) {
+					break;
+				}
+				expand(index, to_move);
+			}
+			index = select_child(nodes[index]);
+			path[depth++] = index;
+			to_move = 1 - to_move;
+		}
+
+		// Each node scores for the player that moved into it, the opponent of the one to move
+		uint64_t count = (uint64_t) leaf_playouts;
+		uint64_t value = evaluate(nodes[index], to_move, leaf_playouts);
+		for (int i = depth - 1; i >= 0; --i) {
+			value = 2 * count - value;
+			nodes[path[i]].visits += count;
+			nodes[path[i]].score += value;
+		}
+		playouts += count;
+	}
+
+	mcts_node_t const &root = nodes[0];
+	uint32_t best = root.first_child;
+	for (uint32_t i = root.first_child; i < root.first_child + root.child_count; ++i) {
+		if (nodes[i].visits > nodes[best].visits) {
+			best = i;
+		}
+	}
+	return unpack_move(nodes[best].move, player);
+}
+
+move_t mcts_ai(game_state_t const &state, int player) {
+	thread_local mcts_t mcts(mcts_options, get_thread_rng().next());
+	mcts.options = mcts_options;
+	return mcts.get_move(state, player);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "rollout.h"
+#include "search.h"
+
+#include <cstdint>
+#include <vector>
+
+struct mcts_options_t {
+	int playouts = 200000; // 0 plays until the time budget runs out, or the default count without one
+	int time_budget_ms = 0; // 0 searches without a time limit
+	int leaf_playouts = 32; // random games per expanded leaf, rounded up to whole batches
+	double exploration = 1.4;
+	bool reuse_tree = false; // keep the subtree of the position reached two plies later
+	size_t max_nodes = 1 << 20; // leaves are only played out once the tree is this large
+};
+
+extern mcts_options_t mcts_options;
+
+// A node of the search tree, reached from its parent by `move`. Children are stored next to
+// each other, and scores count 2 per win and 1 per draw for the player that made `move`.
+struct mcts_node_t {
+	game_state_t state;
+	uint64_t score;
+	uint64_t visits; // 64 bits, a reused root passes 2^32 playouts within minutes
+	uint32_t first_child;
+	uint8_t child_count;
+	uint8_t move;
+	int8_t victor;
+	bool expanded;
+};
+
+static_assert(sizeof(mcts_node_t) == 32, "nodes should stay half a cache line");
+
+// Monte Carlo tree search with UCT selection and batched random playouts. One instance
+// holds the tree and the playout generators, and is only used by one thread at a time.
+struct mcts_t {
+	mcts_options_t options;
+	std::vector<mcts_node_t> nodes; // nodes[0] is the root
+	int root_player = 0;
+	lane_rng_t<rollout_lanes_t> rng;
+	uint64_t playouts = 0; // played by the last get_move, including the reused subtree
+
+	explicit mcts_t(mcts_options_t const &options, uint64_t seed = 1);
+
+	void seed(uint64_t seed);
+
+	// Forgets the tree, for a new game
+	void clear();
+
+	move_t get_move(game_state_t const &state, int player);
+
+	void set_root(game_state_t const &state, int player);
+	void expand(uint32_t index, int player);
+	uint32_t select_child(mcts_node_t const &node) const;
+	uint64_t evaluate(mcts_node_t const &node, int player, int count);
+};
+
+// Plays with a tree per thread and the global MCTS options
+move_t mcts_ai(game_state_t const &state, int player);
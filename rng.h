@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+constexpr uint64_t splitmix64(uint64_t &state) {
+	uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+// xoshiro256**: small, fast, and unlike rand() it has no hidden shared state, so every
+// thread can own one and replay exactly the same sequence from the same seed.
+struct rng_t {
+	uint64_t state[4];
+
+	explicit rng_t(uint64_t seed = 1) {
+		reseed(seed);
+	}
+
+	void reseed(uint64_t seed) {
+		for (auto &word: state) {
+			word = splitmix64(seed);
+		}
+	}
+
+	uint64_t next() {
+		uint64_t result = rotate_left(state[1] * 5, 7) * 9;
+		uint64_t t = state[1] << 17;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = rotate_left(state[3], 45);
+		return result;
+	}
+
+	// Uniform in [0, bound)
+	uint32_t next_below(uint32_t bound) {
+		return (uint32_t) (((next() >> 32) * bound) >> 32);
+	}
+
+	static uint64_t rotate_left(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+};
+
+// The generator used by brains that need randomness, one per thread
+inline rng_t &get_thread_rng() {
+	thread_local rng_t rng;
+	return rng;
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "game.h"
+
+#include <cstdint>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Random playouts for Monte Carlo search, many games at a time. The boards of a batch are
+// kept as a structure of arrays with one 32-bit lane per game, so that every step of a
+// playout (move generation, picking a move, placing it, checking for a line) is a handful of
+// vector instructions over all lanes. All games of a batch start from the same position, so
+// the player to move is the same in every lane and the boards are kept from the point of
+// view of the player to move ("mine" and "theirs"), swapped after every ply.
+//
+// Lane types wrap one vector register; the widest one the compiler targets is used. Build
+// with -DTICTACTOE_NATIVE_ARCH=ON (or -mavx2) for AVX2, x86-64 always has SSE2.
+
+struct scalar_lanes_t {
+	typedef uint32_t vector_t;
+	static constexpr int COUNT = 1;
+
+	static vector_t set(uint32_t value) { return value; }
+	static vector_t load(uint32_t const *values) { return *values; }
+	static void store(uint32_t *values, vector_t v) { *values = v; }
+	static vector_t bit_and(vector_t a, vector_t b) { return a & b; }
+	static vector_t bit_or(vector_t a, vector_t b) { return a | b; }
+	static vector_t bit_xor(vector_t a, vector_t b) { return a ^ b; }
+	static vector_t and_not(vector_t a, vector_t b) { return ~a & b; }
+	static vector_t add(vector_t a, vector_t b) { return a + b; }
+	static vector_t sub(vector_t a, vector_t b) { return a - b; }
+	template<int N> static vector_t shift_left(vector_t a) { return a << N; }
+	template<int N> static vector_t shift_right(vector_t a) { return a >> N; }
+	static vector_t equal(vector_t a, vector_t b) { return a == b ? ~0u : 0u; }
+	// (a * b) >> 16 for a and b below 2^16
+	static vector_t multiply_high16(vector_t a, vector_t b) { return (a * b) >> 16; }
+	static bool any(vector_t a) { return a != 0; }
+	static bool all(vector_t a) { return a == ~0u; }
+};
+
+#if defined(__SSE2__)
+struct sse2_lanes_t {
+	typedef __m128i vector_t;
+	static constexpr int COUNT = 4;
+
+	static vector_t set(uint32_t value) { return _mm_set1_epi32((int) value); }
+	static vector_t load(uint32_t const *values) { return _mm_loadu_si128((__m128i const *) values); }
+	static void store(uint32_t *values, vector_t v) { _mm_storeu_si128((__m128i *) values, v); }
+	static vector_t bit_and(vector_t a, vector_t b) { return _mm_and_si128(a, b); }
+	static vector_t bit_or(vector_t a, vector_t b) { return _mm_or_si128(a, b); }
+	static vector_t bit_xor(vector_t a, vector_t b) { return _mm_xor_si128(a, b); }
+	static vector_t and_not(vector_t a, vector_t b) { return _mm_andnot_si128(a, b); }
+	static vector_t add(vector_t a, vector_t b) { return _mm_add_epi32(a, b); }
+	static vector_t sub(vector_t a, vector_t b) { return _mm_sub_epi32(a, b); }
+	template<int N> static vector_t shift_left(vector_t a) { return _mm_slli_epi32(a, N); }
+	template<int N> static vector_t shift_right(vector_t a) { return _mm_srli_epi32(a, N); }
+	static vector_t equal(vector_t a, vector_t b) { return _mm_cmpeq_epi32(a, b); }
+	// The high halves of the lanes are zero, so a 16-bit multiply gives the whole product
+	static vector_t multiply_high16(vector_t a, vector_t b) { return _mm_mulhi_epu16(a, b); }
+	static bool any(vector_t a) { return _mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128())) != 0xffff; }
+	static bool all(vector_t a) { return _mm_movemask_epi8(a) == 0xffff; }
+};
+#endif
+
+#if defined(__AVX2__)
+struct avx2_lanes_t {
+	typedef __m256i vector_t;
+	static constexpr int COUNT = 8;
+
+	static vector_t set(uint32_t value) { return _mm256_set1_epi32((int) value); }
+	static vector_t load(uint32_t const *values) { return _mm256_loadu_si256((__m256i const *) values); }
+	static void store(uint32_t *values, vector_t v) { _mm256_storeu_si256((__m256i *) values, v); }
+	static vector_t bit_and(vector_t a, vector_t b) { return _mm256_and_si256(a, b); }
+	static vector_t bit_or(vector_t a, vector_t b) { return _mm256_or_si256(a, b); }
+	static vector_t bit_xor(vector_t a, vector_t b) { return _mm256_xor_si256(a, b); }
+	static vector_t and_not(vector_t a, vector_t b) { return _mm256_andnot_si256(a, b); }
+	static vector_t add(vector_t a, vector_t b) { return _mm256_add_epi32(a, b); }
+	static vector_t sub(vector_t a, vector_t b) { return _mm256_sub_epi32(a, b); }
+	template<int N> static vector_t shift_left(vector_t a) { return _mm256_slli_epi32(a, N); }
+	template<int N> static vector_t shift_right(vector_t a) { return _mm256_srli_epi32(a, N); }
+	static vector_t equal(vector_t a, vector_t b) { return _mm256_cmpeq_epi32(a, b); }
+	static vector_t multiply_high16(vector_t a, vector_t b) { return _mm256_mulhi_epu16(a, b); }
+	static bool any(vector_t a) { return !_mm256_testz_si256(a, a); }
+	static bool all(vector_t a) { return _mm256_movemask_epi8(a) == -1; }
+};
+#endif
+
+#if defined(__AVX2__)
+typedef avx2_lanes_t rollout_lanes_t;
+#elif defined(__SSE2__)
+typedef sse2_lanes_t rollout_lanes_t;
+#else
+typedef scalar_lanes_t rollout_lanes_t;
+#endif
+
+static_assert(PIECE_SIZES == 3 && BOARD_TILES == 9, "the rollout move masks assume 3 sizes of 9 tiles");
+
+// One xoshiro128+ generator per lane, stored as four vectors of state words. Only the upper
+// bits are used, which are the good ones for this generator.
+template<typename lanes_t>
+struct lane_rng_t {
+	alignas(32) uint32_t state[4][lanes_t::COUNT];
+
+	void seed(uint64_t seed) {
+		for (int lane = 0; lane < lanes_t::COUNT; ++lane) {
+			// A state of all zeros would never leave zero
+			uint64_t low = splitmix64(seed), high = splitmix64(seed) | 1;
+			state[0][lane] = (uint32_t) low;
+			state[1][lane] = (uint32_t) (low >> 32);
+			state[2][lane] = (uint32_t) high;
+			state[3][lane] = (uint32_t) (high >> 32);
+		}
+	}
+};
+
+// Plays `batches` x lanes_t::COUNT uniformly random games from an undecided state and returns
+// the sum of their results for `player`, the player to move: 2 for a win, 1 for a draw and 0
+// for a loss.
+template<typename lanes_t>
+uint64_t run_rollouts(lane_rng_t<lanes_t> &rng, game_state_t const &state, int player, int batches) {
+	typedef typename lanes_t::vector_t vector_t;
+	vector_t const zero = lanes_t::set(0), ones = lanes_t::set(~0u);
+	vector_t const board = lanes_t::set(BOARD_MASK);
+	vector_t const size_bits[3] = {lanes_t::set(BOARD_MASK), lanes_t::set(BOARD_MASK << BOARD_TILES),
+	                               lanes_t::set(BOARD_MASK << 2 * BOARD_TILES)};
+	vector_t const counter_ones[3] = {lanes_t::set(1), lanes_t::set(1 << 2), lanes_t::set(1 << 4)};
+	vector_t const counter_masks[3] = {lanes_t::set(3), lanes_t::set(3 << 2), lanes_t::set(3 << 4)};
+	vector_t lines[victory_masks.COUNT];
+	for (int i = 0; i < victory_masks.COUNT; ++i) {
+		lines[i] = lanes_t::set(victory_masks.masks[i]);
+	}
+
+	uint32_t remaining[2] = {};
+	for (int i = 0; i < 2; ++i) {
+		for (int j = 0; j < PIECE_SIZES; ++j) {
+			remaining[i] |= get_remaining_moves(state, i, j) << 2 * j;
+		}
+	}
+
+	vector_t s0 = lanes_t::load(rng.state[0]), s1 = lanes_t::load(rng.state[1]);
+	vector_t s2 = lanes_t::load(rng.state[2]), s3 = lanes_t::load(rng.state[3]);
+
+	uint64_t total = 0;
+	for (int batch = 0; batch < batches; ++batch) {
+		vector_t mine = lanes_t::set(get_owner_mask(state, player));
+		vector_t theirs = lanes_t::set(get_owner_mask(state, 1 - player));
+		vector_t sizes[3] = {lanes_t::set(get_size_mask(state, 0)), lanes_t::set(get_size_mask(state, 1)),
+		                     lanes_t::set(get_size_mask(state, 2))};
+		vector_t my_remaining = lanes_t::set(remaining[player]);
+		vector_t their_remaining = lanes_t::set(remaining[1 - player]);
+		vector_t done = zero;
+		vector_t result = zero;
+
+		// Results of the player to move, from the point of view of `player`
+		for (bool root_to_move = true; !lanes_t::all(done); root_to_move = !root_to_move) {
+			vector_t win = lanes_t::set(root_to_move ? 2 : 0), loss = lanes_t::set(root_to_move ? 0 : 2);
+
+			// All valid moves as one 27-bit mask, 9 tiles per size
+			vector_t blocked = lanes_t::bit_or(mine, sizes[2]);
+			vector_t moves = zero;
+			for (int size = 2; size >= 0; --size) {
+				if (size < 2) {
+					blocked = lanes_t::bit_or(blocked, sizes[size]);
+				}
+				vector_t empty = lanes_t::equal(lanes_t::bit_and(my_remaining, counter_masks[size]), zero);
+				vector_t targets = lanes_t::and_not(lanes_t::bit_or(blocked, empty), board);
+				moves = lanes_t::bit_or(lanes_t::template shift_left<BOARD_TILES>(moves), targets);
+			}
+
+			// Population count of the 27 bits
+			vector_t count = lanes_t::sub(moves, lanes_t::bit_and(lanes_t::template shift_right<1>(moves),
+			                                                      lanes_t::set(0x55555555)));
+			count = lanes_t::add(lanes_t::bit_and(count, lanes_t::set(0x33333333)),
+			                     lanes_t::bit_and(lanes_t::template shift_right<2>(count), lanes_t::set(0x33333333)));
+			count = lanes_t::bit_and(lanes_t::add(count, lanes_t::template shift_right<4>(count)),
+			                         lanes_t::set(0x0f0f0f0f));
+			count = lanes_t::add(count, lanes_t::template shift_right<8>(count));
+			count = lanes_t::bit_and(lanes_t::add(count, lanes_t::template shift_right<16>(count)), lanes_t::set(63));
+
+			// A player without a valid move has to yield
+			vector_t stuck = lanes_t::and_not(done, lanes_t::equal(count, zero));
+			result = lanes_t::bit_or(result, lanes_t::bit_and(stuck, loss));
+			done = lanes_t::bit_or(done, stuck);
+
+			// Pick the index of the move below count, then clear that many low bits
+			vector_t random = lanes_t::add(s0, s3);
+			vector_t t = lanes_t::template shift_left<9>(s1);
+			s2 = lanes_t::bit_xor(s2, s0);
+			s3 = lanes_t::bit_xor(s3, s1);
+			s1 = lanes_t::bit_xor(s1, s2);
+			s0 = lanes_t::bit_xor(s0, s3);
+			s2 = lanes_t::bit_xor(s2, t);
+			s3 = lanes_t::bit_or(lanes_t::template shift_left<11>(s3), lanes_t::template shift_right<21>(s3));
+			vector_t index = lanes_t::multiply_high16(lanes_t::template shift_right<16>(random), count);
+			while (true) {
+				vector_t skip = lanes_t::and_not(lanes_t::equal(index, zero), ones);
+				if (!lanes_t::any(skip)) {
+					break;
+				}
+				vector_t cleared = lanes_t::bit_and(moves, lanes_t::sub(moves, lanes_t::set(1)));
+				moves = lanes_t::bit_or(lanes_t::bit_and(skip, cleared), lanes_t::and_not(skip, moves));
+				index = lanes_t::add(index, skip);
+			}
+			vector_t move = lanes_t::bit_and(moves, lanes_t::sub(zero, moves));
+			move = lanes_t::and_not(done, move);
+
+			vector_t tile = lanes_t::bit_or(move, lanes_t::bit_or(lanes_t::template shift_right<BOARD_TILES>(move),
+			                                                     lanes_t::template shift_right<2 * BOARD_TILES>(move)));
+			tile = lanes_t::bit_and(tile, board);
+			mine = lanes_t::bit_or(mine, tile);
+			theirs = lanes_t::and_not(tile, theirs);
+			for (int size = 0; size < PIECE_SIZES; ++size) {
+				vector_t placed = lanes_t::and_not(lanes_t::equal(lanes_t::bit_and(move, size_bits[size]), zero), ones);
+				sizes[size] = lanes_t::bit_or(lanes_t::and_not(tile, sizes[size]), lanes_t::bit_and(placed, tile));
+				my_remaining = lanes_t::sub(my_remaining, lanes_t::bit_and(placed, counter_ones[size]));
+			}
+
+			// Running out of pieces is a draw even when the last one completes a line
+			vector_t active = lanes_t::and_not(done, ones);
+			vector_t draw = lanes_t::bit_and(active, lanes_t::equal(lanes_t::bit_or(my_remaining, their_remaining), zero));
+			result = lanes_t::bit_or(result, lanes_t::bit_and(draw, lanes_t::set(1)));
+			done = lanes_t::bit_or(done, draw);
+
+			vector_t line = zero;
+			for (auto const &mask: lines) {
+				line = lanes_t::bit_or(line, lanes_t::equal(lanes_t::bit_and(mine, mask), mask));
+			}
+			line = lanes_t::and_not(done, line);
+			result = lanes_t::bit_or(result, lanes_t::bit_and(line, win));
+			done = lanes_t::bit_or(done, line);
+
+			std::swap(mine, theirs);
+			std::swap(my_remaining, their_remaining);
+		}
+
+		alignas(32) uint32_t results[lanes_t::COUNT];
+		lanes_t::store(results, result);
+		for (uint32_t lane_result: results) {
+			total += lane_result;
+		}
+	}
+
+	lanes_t::store(rng.state[0], s0);
+	lanes_t::store(rng.state[1], s1);
+	lanes_t::store(rng.state[2], s2);
+	lanes_t::store(rng.state[3], s3);
+	return total;
+}
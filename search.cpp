@@ -0,0 +1,441 @@
+#include "search.h"
+#include "tablebase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <type_traits>
+
+template<typename config_t>
+int get_score_for_moves_left(basic_game_state_t<config_t> const &state, int player) {
+	int total = 0;
+	for (int i = 0; i < config_t::PIECE_SIZES; ++i) {
+		total += get_remaining_moves(state, player, i) * (i * 5);
+	}
+
+	return total;
+}
+
+template<typename config_t>
+int get_score(basic_game_state_t<config_t> const &state, int player) {
+	int victory = get_victor(state);
+	if (victory == -1) {
+		// Relative to the opponent, so that the score of one player is minus the other's, as
+		// negamax needs. Scoring only the player's own pieces let a position look good for both.
+		return get_score_for_moves_left(state, player) - get_score_for_moves_left(state, 1 - player);
+	}
+	if (victory == player)
+		return WIN_SCORE;
+	if (victory == 1 - player)
+		return -WIN_SCORE;
+
+	return 0;
+}
+
+transposition_table_t cache(DEFAULT_TRANSPOSITION_TABLE_MB);
+
+search_options_t search_options;
+
+// Forced win scores are stored relative to the node rather than the root, so that entries
+// remain correct when the same position is reached at a different ply or on a later move.
+inline int score_to_cache(int score, int ply) {
+	if (score > WIN_THRESHOLD) return score + ply;
+	if (score < -WIN_THRESHOLD) return score - ply;
+	return score;
+}
+
+inline int score_from_cache(int score, int ply) {
+	if (score > WIN_THRESHOLD) return score - ply;
+	if (score < -WIN_THRESHOLD) return score + ply;
+	return score;
+}
+
+constexpr uint64_t TIME_CHECK_INTERVAL = 1024;
+
+// Only interior nodes check, so the check is due once TIME_CHECK_INTERVAL nodes of any kind
+// have been searched since the last one, rather than on exact multiples of the interval
+inline bool should_stop(search_context_t &context) {
+	if (context.nodes >= context.next_time_check) {
+		context.next_time_check = context.nodes + TIME_CHECK_INTERVAL;
+		if ((context.has_deadline && std::chrono::steady_clock::now() >= context.deadline) ||
+		    (context.stop_signal && context.stop_signal->load(std::memory_order_relaxed))) {
+			context.stopped = true;
+		}
+	}
+	return context.stopped;
+}
+
+// Move ordering bonus of each tile: 10 for every line through it, which on the 3x3 board
+// puts the center first, then the corners
+template<typename config_t>
+struct tile_bonuses_t {
+	int bonuses[config_t::BOARD_TILES];
+
+	constexpr tile_bonuses_t() : bonuses() {
+		for (auto mask: victory_masks_for<config_t>.masks) {
+			for (int i = 0; i < config_t::BOARD_TILES; ++i) {
+				if ((mask >> i) & 1) {
+					bonuses[i] += 10;
+				}
+			}
+		}
+	}
+};
+
+template<typename config_t>
+constexpr tile_bonuses_t<config_t> tile_bonuses;
+
+// Ordering: hash move, then immediate wins, then gobbles of the biggest pieces, then the
+// tiles on the most lines. Among the rest, smaller pieces are tried first to keep big ones.
+template<typename config_t>
+int get_move_order_score(basic_game_state_t<config_t> const &state, move_t const &move, uint8_t hash_move,
+                         typename config_t::tile_mask_t winning_tiles) {
+	if (hash_move != NO_PACKED_MOVE && pack_move<config_t>(move) == hash_move) {
+		return 1 << 24;
+	}
+
+	int score = 0;
+	auto tile = (typename config_t::tile_mask_t) 1 << move.position;
+	if (winning_tiles & tile) {
+		score += 1 << 20;
+	}
+	if (get_owner_mask(state, 1 - move.player) & tile) {
+		score += 1000 * (1 + get_tile_size(state, move.position));
+	}
+	return score + tile_bonuses<config_t>.bonuses[move.position] - move.size;
+}
+
+template<typename config_t>
+void score_moves(basic_move_list_t<config_t> const &moves, basic_game_state_t<config_t> const &state,
+                 uint8_t hash_move, int *scores) {
+
+	// The tiles that complete a line for the player to move, found once rather than per move
+	typename config_t::tile_mask_t owned = get_owner_mask(state, moves[0].player), winning_tiles = 0;
+	for (auto mask: victory_masks_for<config_t>.masks) {
+		auto missing = mask & ~owned;
+		if (missing && !(missing & (missing - 1))) {
+			winning_tiles |= missing;
+		}
+	}
+
+	for (int i = 0; i < moves.count; ++i) {
+		scores[i] = get_move_order_score(state, moves[i], hash_move, winning_tiles);
+	}
+}
+
+// Brings the best of the moves from `index` on to `index`, keeping the others in order, so
+// that picking them one at a time gives a stable sort. Nodes that are cut off after a few
+// moves never pay for ordering the rest of a long move list.
+template<typename config_t>
+void pick_move(basic_move_list_t<config_t> &moves, int *scores, int index) {
+	int best = index;
+	for (int i = index + 1; i < moves.count; ++i) {
+		if (scores[i] > scores[best]) {
+			best = i;
+		}
+	}
+	move_t move = moves[best];
+	int score = scores[best];
+	for (int i = best; i > index; --i) {
+		moves[i] = moves[i - 1];
+		scores[i] = scores[i - 1];
+	}
+	moves[index] = move;
+	scores[index] = score;
+}
+
+// Principal variation search: negamax with alpha-beta pruning, where every move after the
+// first is searched with a null window and only re-searched if it turns out to be better.
+template<typename config_t>
+std::pair<move_t, int> maximize(search_context_t &context, basic_position_t<config_t> &position, int player,
+                                int depth_left, int ply, int alpha, int beta) {
+	context.nodes++;
+	SEARCH_STAT(context.stats.max_ply = std::max(context.stats.max_ply, ply));
+
+	basic_game_state_t<config_t> const &state = position.state;
+	int victory = get_victor(state);
+	if (victory != -1) {
+		int score = get_score(state, player);
+		return {{}, score > 0 ? score - ply : score < 0 ? score + ply : 0};
+	}
+	if (depth_left <= 0) {
+		return {{}, get_score(state, player)};
+	}
+	if (should_stop(context)) {
+		return {{}, 0};
+	}
+
+	// Symmetric positions share one cache entry, with its move in the canonical orientation
+	auto canonical = get_canonical_hash(position);
+	int from_canonical = symmetry_tables_for<config_t>.inverse[canonical.symmetry];
+	uint64_t key = get_cache_key<config_t>(canonical, player);
+	uint8_t hash_move = NO_PACKED_MOVE;
+	transposition_data_t entry;
+	SEARCH_STAT(context.stats.cache_probes++);
+	if (context.cache->probe(key, entry)) {
+		SEARCH_STAT(context.stats.cache_hits++);
+		move_t cached_move = transform_move<config_t>(unpack_move<config_t>(entry.move, player), from_canonical);
+		hash_move = pack_move<config_t>(cached_move);
+		if (entry.depth >= depth_left && ply > 0) {
+			int score = score_from_cache(entry.score, ply);
+			if (entry.bound == BOUND_EXACT ||
+			    (entry.bound == BOUND_LOWER && score >= beta) ||
+			    (entry.bound == BOUND_UPPER && score <= alpha)) {
+				SEARCH_STAT(context.stats.cache_cutoffs++);
+				return {cached_move, score};
+			}
+		}
+	}
+
+	basic_move_list_t<config_t> moves;
+	generate_moves(state, player, moves, ply == 0);
+	if (moves.empty()) {
+		// Nowhere to place a piece, the player has to yield and loses
+		return {{player, -1, -1, true}, -(WIN_SCORE - ply - 1)};
+	}
+	int scores[config_t::MAX_MOVES];
+	score_moves(moves, state, hash_move, scores);
+	if (ply == 0) {
+		for (int i = 0; i < moves.count; ++i) {
+			pick_move(moves, scores, i);
+		}
+		if (context.thread_index > 0) {
+			// Helper threads start from different root moves to spread out over the tree
+			std::rotate(moves.begin(), moves.begin() + context.thread_index % moves.count, moves.end());
+		}
+	}
+
+	int original_alpha = alpha;
+	std::pair<move_t, int> best_result = {{}, -INFINITE_SCORE};
+	for (int i = 0; i < moves.count; ++i) {
+		if (ply > 0) {
+			pick_move(moves, scores, i);
+		}
+		auto const &move = moves[i];
+		if (i == 0) {
+			best_result.first = move;
+		}
+		basic_undo_t<config_t> undo;
+		make_move(position, move, undo);
+
+		int score;
+		if (i == 0) {
+			score = -maximize(context, position, 1 - player, depth_left - 1, ply + 1, -beta, -alpha).second;
+		} else {
+			score = -maximize(context, position, 1 - player, depth_left - 1, ply + 1, -alpha - 1, -alpha).second;
+			if (score > alpha && score < beta) {
+				score = -maximize(context, position, 1 - player, depth_left - 1, ply + 1, -beta, -alpha).second;
+			}
+		}
+		unmake_move(position, move, undo);
+		if (context.stopped) {
+			return best_result;
+		}
+
+		if (score > best_result.second) {
+			best_result = {move, score};
+		}
+		if (score > alpha) {
+			alpha = score;
+		}
+		if (alpha >= beta) {
+			SEARCH_STAT(context.stats.beta_cutoffs++);
+			SEARCH_STAT(context.stats.first_move_cutoffs += i == 0);
+			break;
+		}
+	}
+
+	bound_t bound = BOUND_EXACT;
+	if (best_result.second <= original_alpha) {
+		bound = BOUND_UPPER;
+	} else if (best_result.second >= beta) {
+		bound = BOUND_LOWER;
+	}
+	uint8_t canonical_move = pack_move<config_t>(transform_move<config_t>(best_result.first, canonical.symmetry));
+	bool overwrote = context.cache->store(key, canonical_move, score_to_cache(best_result.second, ply), depth_left, bound);
+	SEARCH_STAT(context.stats.cache_stores++);
+	SEARCH_STAT(context.stats.cache_overwrites += overwrote);
+	(void) overwrote;
+	return best_result;
+}
+
+template<typename config_t>
+std::pair<move_t, int> search_iteratively(search_context_t &context, basic_game_state_t<config_t> const &state,
+                                          int player, int first_depth, int max_depth) {
+	basic_position_t<config_t> position = get_position(state);
+	std::pair<move_t, int> best_result = {{player, -1, -1, true}, -WIN_SCORE};
+	for (int depth = first_depth; depth <= max_depth; ++depth) {
+#ifdef TICTACTOE_SEARCH_STATS
+		auto iteration_start = std::chrono::steady_clock::now();
+		uint64_t iteration_nodes = context.nodes;
+#endif
+		auto result = maximize(context, position, player, depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+		if (context.stopped && depth > first_depth) {
+			break;
+		}
+		best_result = result;
+#ifdef TICTACTOE_SEARCH_STATS
+		auto &stats = context.stats;
+		if (stats.iteration_count <= MAX_GAME_PLY) {
+			auto elapsed = std::chrono::steady_clock::now() - iteration_start;
+			stats.iterations[stats.iteration_count++] = {
+					depth, result.second, context.nodes - iteration_nodes,
+					std::chrono::duration<double, std::milli>(elapsed).count()};
+		}
+		stats.depth = depth;
+#endif
+		if (context.stopped || best_result.second > WIN_THRESHOLD || best_result.second < -WIN_THRESHOLD) {
+			break;
+		}
+	}
+
+	return best_result;
+}
+
+#ifdef TICTACTOE_SEARCH_STATS
+thread_local search_stats_t last_search_stats;
+
+void search_stats_t::add(search_stats_t const &other) {
+	nodes += other.nodes;
+	cache_probes += other.cache_probes;
+	cache_hits += other.cache_hits;
+	cache_cutoffs += other.cache_cutoffs;
+	cache_stores += other.cache_stores;
+	cache_overwrites += other.cache_overwrites;
+	beta_cutoffs += other.beta_cutoffs;
+	first_move_cutoffs += other.first_move_cutoffs;
+	max_ply = std::max(max_ply, other.max_ply);
+}
+
+search_stats_t const &get_last_search_stats() {
+	return last_search_stats;
+}
+
+double get_ratio(uint64_t part, uint64_t total) {
+	return total ? (double) part / (double) total : 0.0;
+}
+
+void write_search_stats_json(FILE *file, search_stats_t const &stats, int player, int remaining_plies) {
+	// Effective branching factor: the geometric mean of how much each iteration grew over the
+	// one before, from the main thread's completed iterations. 0 with fewer than two.
+	double branching_factor = 0.0;
+	if (stats.iteration_count >= 2) {
+		auto const &first = stats.iterations[0], &last = stats.iterations[stats.iteration_count - 1];
+		if (first.nodes > 0 && last.depth > first.depth) {
+			branching_factor = pow((double) last.nodes / first.nodes, 1.0 / (last.depth - first.depth));
+		}
+	}
+	// Self-play workers may share the file, and each line has to stay in one piece
+	flockfile(file);
+	fprintf(file, "{\"player\":%i,\"remaining_plies\":%i,\"threads\":%i,\"milliseconds\":%.3f,\"nodes\":%llu,"
+	              "\"nodes_per_second\":%.0f,\"depth\":%i,\"max_ply\":%i,\"score\":%i,"
+	              "\"move\":{\"position\":%i,\"size\":%i,\"yield\":%s},"
+	              "\"cache_probes\":%llu,\"cache_hits\":%llu,\"cache_hit_rate\":%.4f,\"cache_cutoffs\":%llu,"
+	              "\"cache_stores\":%llu,\"cache_overwrites\":%llu,\"beta_cutoffs\":%llu,"
+	              "\"first_move_cutoff_rate\":%.4f,\"branching_factor\":%.3f,\"iterations\":[",
+	        player, remaining_plies, stats.threads, stats.milliseconds, (unsigned long long) stats.nodes,
+	        stats.nodes / std::max(stats.milliseconds / 1000.0, 1e-9), stats.depth, stats.max_ply, stats.score,
+	        stats.move.position, stats.move.size, stats.move.yield ? "true" : "false",
+	        (unsigned long long) stats.cache_probes, (unsigned long long) stats.cache_hits,
+	        get_ratio(stats.cache_hits, stats.cache_probes), (unsigned long long) stats.cache_cutoffs,
+	        (unsigned long long) stats.cache_stores, (unsigned long long) stats.cache_overwrites,
+	        (unsigned long long) stats.beta_cutoffs, get_ratio(stats.first_move_cutoffs, stats.beta_cutoffs),
+	        branching_factor);
+	for (int i = 0; i < stats.iteration_count; ++i) {
+		auto const &iteration = stats.iterations[i];
+		fprintf(file, "%s{\"depth\":%i,\"score\":%i,\"nodes\":%llu,\"milliseconds\":%.3f}", i ? "," : "",
+		        iteration.depth, iteration.score, (unsigned long long) iteration.nodes, iteration.milliseconds);
+	}
+	fprintf(file, "]}\n");
+	fflush(file);
+	funlockfile(file);
+}
+#endif
+
+template<typename config_t>
+std::pair<move_t, int> search(basic_game_state_t<config_t> const &state, int player, search_options_t const &options) {
+#ifdef TICTACTOE_SEARCH_STATS
+	auto start = std::chrono::steady_clock::now();
+#endif
+	transposition_table_t &table = options.cache ? *options.cache : cache;
+	std::atomic<bool> stop_signal(false);
+	std::vector<search_context_t> contexts(std::max(options.threads, 1));
+	for (size_t i = 0; i < contexts.size(); ++i) {
+		auto &context = contexts[i];
+		if (options.time_budget_ms > 0) {
+			context.has_deadline = true;
+			context.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.time_budget_ms);
+		}
+		context.thread_index = (int) i;
+		context.stop_signal = &stop_signal;
+		context.cache = &table;
+	}
+	table.new_search();
+
+	int max_depth = std::max(std::min(options.max_depth, get_remaining_plies(state)), 1);
+	std::vector<std::thread> helpers;
+	for (size_t i = 1; i < contexts.size(); ++i) {
+		int first_depth = std::min(1 + (int) (i % 2), max_depth);
+		helpers.emplace_back([&, i, first_depth]() {
+			search_iteratively(contexts[i], state, player, first_depth, max_depth);
+		});
+	}
+
+	auto best_result = search_iteratively(contexts[0], state, player, 1, max_depth);
+
+	stop_signal.store(true, std::memory_order_relaxed);
+	for (auto &helper: helpers) {
+		helper.join();
+	}
+
+#ifdef TICTACTOE_SEARCH_STATS
+	// Iterations and depth are the main thread's, the counters are summed over all threads
+	search_stats_t stats = contexts[0].stats;
+	stats.nodes = 0;
+	stats.cache_probes = stats.cache_hits = stats.cache_cutoffs = stats.cache_stores = stats.cache_overwrites = 0;
+	stats.beta_cutoffs = stats.first_move_cutoffs = 0;
+	for (auto &context: contexts) {
+		context.stats.nodes = context.nodes;
+		stats.add(context.stats);
+	}
+	stats.threads = (int) contexts.size();
+	stats.score = best_result.second;
+	stats.move = best_result.first;
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	last_search_stats = stats;
+	if (options.stats_output) {
+		write_search_stats_json(options.stats_output, stats, player, get_remaining_plies(state));
+	}
+#endif
+	return best_result;
+}
+
+template<typename config_t>
+move_t get_search_move(basic_game_state_t<config_t> const &state, int player, search_options_t const &options) {
+	if constexpr (std::is_same<config_t, classic_config_t>::value) {
+		if (auto hit = probe_tablebase(tablebase, state, player)) {
+			return hit->move;
+		}
+	}
+	return search(state, player, options).first;
+}
+
+template<typename config_t>
+move_t smarter_ai(basic_game_state_t<config_t> const &state, int player) {
+	return get_search_move(state, player, search_options);
+}
+
+#define INSTANTIATE_SEARCH(config_t) \
+	template int get_score_for_moves_left<config_t>(basic_game_state_t<config_t> const &, int); \
+	template int get_score<config_t>(basic_game_state_t<config_t> const &, int); \
+	template std::pair<move_t, int> maximize<config_t>(search_context_t &, basic_position_t<config_t> &, int, int, int, \
+	                                                   int, int); \
+	template std::pair<move_t, int> search_iteratively<config_t>(search_context_t &, \
+	                                                             basic_game_state_t<config_t> const &, int, int, int); \
+	template std::pair<move_t, int> search<config_t>(basic_game_state_t<config_t> const &, int, \
+	                                                 search_options_t const &); \
+	template move_t get_search_move<config_t>(basic_game_state_t<config_t> const &, int, search_options_t const &); \
+	template move_t smarter_ai<config_t>(basic_game_state_t<config_t> const &, int);
+
+FOR_EACH_GAME_CONFIG(INSTANTIATE_SEARCH)
+
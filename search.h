@@ -0,0 +1,297 @@
+#pragma once
+
+#include "game.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+constexpr int WIN_SCORE = 1000000;
+constexpr int INFINITE_SCORE = WIN_SCORE + 1;
+// Scores beyond this are forced wins or losses, shortened by the number of plies to reach them
+constexpr int WIN_THRESHOLD = WIN_SCORE - 2 * MAX_GAME_PLY;
+
+template<typename config_t>
+int get_score_for_moves_left(basic_game_state_t<config_t> const &state, int player);
+
+// Score of a state from the point of view of the given player: +-WIN_SCORE for a decided
+// game, otherwise the difference in the value of the pieces both players still hold.
+template<typename config_t>
+int get_score(basic_game_state_t<config_t> const &state, int player);
+
+enum bound_t : uint8_t {
+	BOUND_NONE,
+	BOUND_EXACT,
+	BOUND_LOWER,
+	BOUND_UPPER,
+};
+
+// A move packed into one byte: position * PIECE_SIZES + size, or MAX_MOVES for a yield.
+// NO_PACKED_MOVE stands for no move at all. The player is implied by the position the entry
+// belongs to.
+constexpr uint8_t NO_PACKED_MOVE = 0xff;
+
+template<typename config_t = classic_config_t>
+inline uint8_t pack_move(move_t const &move) {
+	if (move.yield) {
+		return config_t::MAX_MOVES;
+	}
+	return (uint8_t) (move.position * config_t::PIECE_SIZES + move.size);
+}
+
+template<typename config_t = classic_config_t>
+inline move_t unpack_move(uint8_t packed, int player) {
+	if (packed == config_t::MAX_MOVES) {
+		return {player, -1, -1, true};
+	}
+	return {player, packed % config_t::PIECE_SIZES, packed / config_t::PIECE_SIZES, false};
+}
+
+// Everything but the key of a cache entry, packed so that it is read and written as one word
+struct transposition_data_t {
+	int32_t score;
+	uint8_t move;
+	uint8_t depth;
+	uint8_t bound;
+	uint8_t generation;
+};
+
+static_assert(sizeof(transposition_data_t) == sizeof(uint64_t), "transposition data must fit in one word");
+
+inline uint64_t pack_transposition_data(transposition_data_t const &data) {
+	uint64_t word;
+	memcpy(&word, &data, sizeof(word));
+	return word;
+}
+
+inline transposition_data_t unpack_transposition_data(uint64_t word) {
+	transposition_data_t data;
+	memcpy(&data, &word, sizeof(data));
+	return data;
+}
+
+// The table is shared by all search threads without locks. The key is stored xor'ed with
+// the data word, so an entry torn by two concurrent writers fails the key check on probe
+// instead of returning a score for the wrong position.
+struct transposition_entry_t {
+	std::atomic<uint64_t> checked_key;
+	std::atomic<uint64_t> data;
+};
+
+static_assert(sizeof(transposition_entry_t) == 16, "transposition entries must stay 16 bytes");
+
+constexpr int TRANSPOSITION_BUCKET_SIZE = 4;
+
+struct alignas(64) transposition_bucket_t {
+	transposition_entry_t entries[TRANSPOSITION_BUCKET_SIZE];
+};
+
+constexpr size_t DEFAULT_TRANSPOSITION_TABLE_MB = 16;
+
+// Fixed-size, depth-preferred transposition table. Memory is allocated once up front and
+// entries are keyed by position, so they remain valid from one move to the next;
+// `new_search` only ages them so that they are the first to be replaced.
+struct transposition_table_t {
+	std::unique_ptr<transposition_bucket_t[]> buckets;
+	size_t bucket_mask = 0;
+	uint8_t generation = 0;
+
+	explicit transposition_table_t(size_t megabytes) {
+		resize(megabytes);
+	}
+
+	void resize(size_t megabytes) {
+		size_t count = 1;
+		while (count * 2 * sizeof(transposition_bucket_t) <= megabytes * 1024 * 1024) {
+			count *= 2;
+		}
+		buckets.reset(new transposition_bucket_t[count]);
+		bucket_mask = count - 1;
+		clear();
+	}
+
+	void clear() {
+		for (size_t i = 0; i <= bucket_mask; ++i) {
+			for (auto &entry: buckets[i].entries) {
+				entry.checked_key.store(0, std::memory_order_relaxed);
+				entry.data.store(0, std::memory_order_relaxed);
+			}
+		}
+		generation = 0;
+	}
+
+	// Only called between searches, while no search threads are running
+	void new_search() {
+		generation++;
+	}
+
+	transposition_bucket_t &get_bucket(uint64_t key) const {
+		// Zobrist keys are already uniformly distributed
+		return buckets[key & bucket_mask];
+	}
+
+	bool probe(uint64_t key, transposition_data_t &out_data) const {
+		for (auto const &entry: get_bucket(key).entries) {
+			uint64_t data = entry.data.load(std::memory_order_relaxed);
+			uint64_t checked_key = entry.checked_key.load(std::memory_order_relaxed);
+			if (data != 0 && (checked_key ^ data) == key) {
+				out_data = unpack_transposition_data(data);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Returns whether the entry of another position was evicted
+	bool store(uint64_t key, uint8_t move, int score, int depth, bound_t bound) {
+		auto &bucket = get_bucket(key);
+		transposition_entry_t *replace = nullptr;
+		transposition_data_t replace_data = {};
+		bool same_key = false;
+		for (auto &entry: bucket.entries) {
+			uint64_t data = entry.data.load(std::memory_order_relaxed);
+			auto entry_data = unpack_transposition_data(data);
+			if (data == 0 || (entry.checked_key.load(std::memory_order_relaxed) ^ data) == key) {
+				replace = &entry;
+				replace_data = entry_data;
+				same_key = data != 0;
+				break;
+			}
+			// Prefer to evict entries from earlier searches, then the shallowest ones
+			if (!replace || get_replace_priority(entry_data) < get_replace_priority(replace_data)) {
+				replace = &entry;
+				replace_data = entry_data;
+			}
+		}
+
+		if (same_key && replace_data.depth > depth && bound != BOUND_EXACT) {
+			return false;
+		}
+
+		uint64_t data = pack_transposition_data({score, move, (uint8_t) depth, bound, generation});
+		replace->data.store(data, std::memory_order_relaxed);
+		replace->checked_key.store(key ^ data, std::memory_order_relaxed);
+		return !same_key && replace_data.bound != BOUND_NONE;
+	}
+
+	int get_replace_priority(transposition_data_t const &data) const {
+		uint8_t age = generation - data.generation;
+		return data.depth - age * 16;
+	}
+};
+
+extern transposition_table_t cache;
+
+// Cache key: the canonical Zobrist hash of the position, with the player to move mixed in
+template<typename config_t>
+inline uint64_t get_cache_key(canonical_hash_t const &canonical, int player) {
+	return canonical.hash ^ (player ? zobrist_keys_for<config_t>.player_to_move : 0);
+}
+
+// Search instrumentation is compiled in with TICTACTOE_SEARCH_STATS. Without it, SEARCH_STAT
+// expands to nothing and the counters below are never touched.
+#ifdef TICTACTOE_SEARCH_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
+
+struct search_iteration_stats_t {
+	int depth;
+	int score;
+	uint64_t nodes; // main thread only, for this iteration
+	double milliseconds;
+};
+
+// Counters are kept per thread in the search context and summed when the search ends
+struct search_stats_t {
+	uint64_t nodes = 0;
+	uint64_t cache_probes = 0;
+	uint64_t cache_hits = 0;
+	uint64_t cache_cutoffs = 0;
+	uint64_t cache_stores = 0;
+	uint64_t cache_overwrites = 0; // stores that evicted another position
+	uint64_t beta_cutoffs = 0;
+	uint64_t first_move_cutoffs = 0; // beta cutoffs on the first move searched
+	int max_ply = 0;
+
+	// Filled in by the main thread for the whole search
+	int threads = 0;
+	int depth = 0; // last completed iteration
+	int score = 0;
+	move_t move = {};
+	double milliseconds = 0;
+	int iteration_count = 0;
+	search_iteration_stats_t iterations[MAX_GAME_PLY + 1] = {};
+
+	void add(search_stats_t const &other);
+};
+
+struct search_options_t {
+	int time_budget_ms = 1000; // 0 searches without a time limit
+	int max_depth = MAX_GAME_PLY; // the end of the game at most
+	int threads = 1;
+	transposition_table_t *cache = nullptr; // the global cache when not set
+	FILE *stats_output = nullptr; // gets one JSON line per search, if stats are compiled in
+};
+
+extern search_options_t search_options;
+
+// Per-thread search state
+struct search_context_t {
+	std::chrono::steady_clock::time_point deadline;
+	bool has_deadline = false;
+	bool stopped = false;
+	uint64_t nodes = 0;
+	uint64_t next_time_check = 0; // node count at which should_stop next reads the clock
+	int thread_index = 0;
+	std::atomic<bool> *stop_signal = nullptr;
+	transposition_table_t *cache = nullptr;
+#ifdef TICTACTOE_SEARCH_STATS
+	search_stats_t stats;
+#endif
+};
+
+// The search is compiled once for every variant in FOR_EACH_GAME_CONFIG, in search.cpp
+
+// Searches the position in place: moves are made and unmade on it, and it is back in its
+// original state on return.
+template<typename config_t>
+std::pair<move_t, int> maximize(search_context_t &context, basic_position_t<config_t> &position, int player,
+                                int depth_left, int ply, int alpha, int beta);
+
+// Iterative deepening on one thread from first_depth up to max_depth, on the context's cache
+template<typename config_t>
+std::pair<move_t, int> search_iteratively(search_context_t &context, basic_game_state_t<config_t> const &state,
+                                          int player, int first_depth, int max_depth);
+
+// Iterative deepening until the time budget runs out, the depth limit is reached, the game
+// is searched to the end or a forced result is found. An iteration that is interrupted by
+// the deadline is discarded in favour of the last completed one.
+//
+// With more than one thread, helper threads run the same iterative deepening (Lazy SMP):
+// odd helpers run one ply ahead and each starts from a different root move, so they fill
+// the shared cache with results the main thread picks up. Only the main thread's result
+// is returned, and the helpers are stopped as soon as it finishes.
+template<typename config_t>
+std::pair<move_t, int> search(basic_game_state_t<config_t> const &state, int player, search_options_t const &options);
+
+#ifdef TICTACTOE_SEARCH_STATS
+// Statistics of the last search() run on the calling thread
+search_stats_t const &get_last_search_stats();
+
+// Writes the statistics as a single line of JSON
+void write_search_stats_json(FILE *file, search_stats_t const &stats, int player, int remaining_plies);
+#endif
+
+// Plays the tablebase move when one is loaded and covers the position, otherwise searches.
+// The tablebase only exists for the 3x3 game.
+template<typename config_t>
+move_t get_search_move(basic_game_state_t<config_t> const &state, int player, search_options_t const &options);
+
+// get_search_move with the global search options
+template<typename config_t>
+move_t smarter_ai(basic_game_state_t<config_t> const &state, int player);
@@ -0,0 +1,201 @@
+#include "selfplay.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Games are handed out to workers in batches, so that the shared counter is not contended
+constexpr uint64_t SELFPLAY_BATCH = 64;
+
+template<typename config_t>
+basic_brain_factory_t<config_t> make_search_brain(search_options_t const &options, size_t cache_megabytes) {
+	return [options, cache_megabytes]() {
+		auto table = std::make_shared<transposition_table_t>(cache_megabytes);
+		search_options_t worker_options = options;
+		worker_options.cache = table.get();
+		worker_options.threads = 1;
+
+		basic_selfplay_brain_t<config_t> brain;
+		brain.play = [table, worker_options](basic_game_state_t<config_t> const &state, int player) {
+			return get_search_move(state, player, worker_options);
+		};
+		brain.new_game = [table]() {
+			table->clear();
+		};
+		return brain;
+	};
+}
+
+brain_factory_t make_mcts_brain(mcts_options_t const &options) {
+	return [options]() {
+		auto mcts = std::make_shared<mcts_t>(options);
+		selfplay_brain_t brain;
+		brain.play = [mcts](game_state_t const &state, int player) {
+			return mcts->get_move(state, player);
+		};
+		brain.new_game = [mcts]() {
+			mcts->clear();
+			mcts->seed(get_thread_rng().next());
+		};
+		return brain;
+	};
+}
+
+template<typename config_t>
+basic_brain_factory_t<config_t> make_stateless_brain(basic_brain_t<config_t> const &brain) {
+	return [brain]() {
+		return basic_selfplay_brain_t<config_t>{brain, []() {}};
+	};
+}
+
+template<typename config_t>
+int play_headless_game(std::array<basic_brain_t<config_t>, 2> const &brains, int &out_plies, bool &out_forfeit) {
+	auto state = get_clear_game_state<config_t>();
+	out_plies = 0;
+	out_forfeit = false;
+	for (int player = 0;; player = 1 - player) {
+		int victor = get_victor(state);
+		if (victor != -1) {
+			return victor;
+		}
+
+		move_t move = brains[player](state, player);
+		std::optional<basic_game_state_t<config_t>> result;
+		if (move.player == player) {
+			result = perform_move(state, move);
+		}
+		if (!result) {
+			out_forfeit = true;
+			result = perform_move(state, {player, -1, -1, true});
+		}
+		state = *result;
+		out_plies++;
+	}
+}
+
+template<typename config_t>
+void run_selfplay_worker(std::array<basic_brain_factory_t<config_t>, 2> const &factories,
+                         selfplay_options_t const &options, std::atomic<uint64_t> &next_game,
+                         selfplay_result_t &result) {
+	std::array<basic_selfplay_brain_t<config_t>, 2> brains = {factories[0](), factories[1]()};
+	// Seating orders, indexed by which brain moves first
+	std::array<basic_brain_t<config_t>, 2> seatings[2] = {
+			{brains[0].play, brains[1].play},
+			{brains[1].play, brains[0].play},
+	};
+
+	uint64_t seed_state = options.seed;
+	uint64_t base_seed = splitmix64(seed_state);
+	auto &rng = get_thread_rng();
+	while (true) {
+		uint64_t begin = next_game.fetch_add(SELFPLAY_BATCH, std::memory_order_relaxed);
+		if (begin >= options.games) {
+			break;
+		}
+
+		uint64_t end = std::min(begin + SELFPLAY_BATCH, options.games);
+		for (uint64_t game = begin; game < end; ++game) {
+			rng.reseed(base_seed ^ game);
+			brains[0].new_game();
+			brains[1].new_game();
+
+			int first = options.swap_sides ? (int) (game & 1) : 0;
+			int plies;
+			bool forfeit;
+			int victor = play_headless_game(seatings[first], plies, forfeit);
+
+			result.games++;
+			if (victor <= 1) {
+				int winner = victor == 0 ? first : 1 - first;
+				result.wins[winner]++;
+				if (victor == 0) {
+					result.wins_as_first[winner]++;
+				}
+			} else {
+				result.draws++;
+			}
+			result.forfeits += forfeit;
+			result.length_counts[std::min(plies, MAX_GAME_PLY)]++;
+		}
+	}
+}
+
+template<typename config_t>
+selfplay_result_t run_selfplay(std::array<basic_brain_factory_t<config_t>, 2> const &brains,
+                               selfplay_options_t const &options) {
+	int threads = options.threads;
+	if (threads <= 0) {
+		threads = (int) std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::atomic<uint64_t> next_game(0);
+	std::vector<selfplay_result_t> partial_results(threads);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; ++i) {
+		workers.emplace_back(run_selfplay_worker<config_t>, std::cref(brains), std::cref(options), std::ref(next_game),
+		                     std::ref(partial_results[i]));
+	}
+	for (auto &worker: workers) {
+		worker.join();
+	}
+
+	selfplay_result_t result;
+	for (auto const &partial: partial_results) {
+		result.games += partial.games;
+		result.draws += partial.draws;
+		result.forfeits += partial.forfeits;
+		for (int i = 0; i < 2; ++i) {
+			result.wins[i] += partial.wins[i];
+			result.wins_as_first[i] += partial.wins_as_first[i];
+		}
+		for (int i = 0; i <= MAX_GAME_PLY; ++i) {
+			result.length_counts[i] += partial.length_counts[i];
+		}
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+#define INSTANTIATE_SELFPLAY(config_t) \
+	template basic_brain_factory_t<config_t> make_search_brain<config_t>(search_options_t const &, size_t); \
+	template basic_brain_factory_t<config_t> make_stateless_brain<config_t>(basic_brain_t<config_t> const &); \
+	template int play_headless_game<config_t>(std::array<basic_brain_t<config_t>, 2> const &, int &, bool &); \
+	template selfplay_result_t run_selfplay<config_t>(std::array<basic_brain_factory_t<config_t>, 2> const &, \
+	                                                  selfplay_options_t const &);
+
+FOR_EACH_GAME_CONFIG(INSTANTIATE_SELFPLAY)
+
+void print_selfplay_result(selfplay_result_t const &result, char const *names[2]) {
+	double games = (double) std::max<uint64_t>(result.games, 1);
+	printf("%s vs %s: %llu games in %.2f s (%.0f games/s)\n", names[0], names[1],
+	       (unsigned long long) result.games, result.seconds, result.games / std::max(result.seconds, 1e-9));
+	for (int i = 0; i < 2; ++i) {
+		printf("  %-8s wins %6.2f%% (%.2f%% of games as player 1)\n", names[i], 100.0 * result.wins[i] / games,
+		       100.0 * result.wins_as_first[i] / games);
+	}
+	printf("  draws    %6.2f%%\n", 100.0 * result.draws / games);
+	printf("  forfeits %llu\n", (unsigned long long) result.forfeits);
+
+	uint64_t total_plies = 0;
+	int min_plies = -1, max_plies = 0;
+	for (int i = 0; i <= MAX_GAME_PLY; ++i) {
+		if (result.length_counts[i] == 0) continue;
+		total_plies += i * result.length_counts[i];
+		if (min_plies == -1) min_plies = i;
+		max_plies = i;
+	}
+	printf("  game length: mean %.2f plies, min %i, max %i\n", total_plies / games, std::max(min_plies, 0), max_plies);
+	printf("  length histogram:");
+	for (int i = 0; i <= MAX_GAME_PLY; ++i) {
+		if (result.length_counts[i] == 0) continue;
+		printf(" %i:%llu", i, (unsigned long long) result.length_counts[i]);
+	}
+	printf("\n");
+}
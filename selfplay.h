@@ -0,0 +1,70 @@
+#pragma once
+
+#include "mcts.h"
+#include "search.h"
+
+#include <array>
+#include <functional>
+
+template<typename config_t>
+using basic_brain_t = std::function<move_t(basic_game_state_t<config_t> const &, int)>;
+
+// A brain as used by one self-play worker. new_game is called before every game so that a
+// brain with state (such as a search cache) plays each game the same no matter which worker
+// runs it or what that worker played before.
+template<typename config_t>
+struct basic_selfplay_brain_t {
+	basic_brain_t<config_t> play;
+	std::function<void()> new_game;
+};
+
+// Called once per worker thread
+template<typename config_t>
+using basic_brain_factory_t = std::function<basic_selfplay_brain_t<config_t>()>;
+
+typedef basic_brain_t<classic_config_t> brain_t;
+typedef basic_selfplay_brain_t<classic_config_t> selfplay_brain_t;
+typedef basic_brain_factory_t<classic_config_t> brain_factory_t;
+
+// Plays with the given options, on a cache owned by the worker. Only deterministic when the
+// options have no time budget.
+template<typename config_t = classic_config_t>
+basic_brain_factory_t<config_t> make_search_brain(search_options_t const &options, size_t cache_megabytes);
+
+// Monte Carlo tree search with a tree per worker, reseeded from the game's seed. Only
+// deterministic when the options have no time budget.
+brain_factory_t make_mcts_brain(mcts_options_t const &options);
+
+template<typename config_t = classic_config_t>
+basic_brain_factory_t<config_t> make_stateless_brain(basic_brain_t<config_t> const &brain);
+
+struct selfplay_options_t {
+	uint64_t games = 1000;
+	int threads = 0; // 0 uses every hardware thread
+	uint64_t seed = 1;
+	bool swap_sides = true; // the second brain moves first in every odd game
+};
+
+struct selfplay_result_t {
+	uint64_t games = 0;
+	uint64_t wins[2] = {}; // per brain
+	uint64_t wins_as_first[2] = {};
+	uint64_t draws = 0;
+	uint64_t forfeits = 0; // games decided by an invalid move
+	uint64_t length_counts[MAX_GAME_PLY + 1] = {};
+	double seconds = 0;
+};
+
+// Plays one game without any output and returns the victor as reported by get_victor.
+// An invalid move counts as yielding.
+template<typename config_t>
+int play_headless_game(std::array<basic_brain_t<config_t>, 2> const &brains, int &out_plies, bool &out_forfeit);
+
+// Plays options.games games between two brains on a pool of worker threads. Game i is
+// played with its own random seed derived from options.seed and i, so the totals only
+// depend on the seed, not on the number of threads or how games are scheduled.
+template<typename config_t>
+selfplay_result_t run_selfplay(std::array<basic_brain_factory_t<config_t>, 2> const &brains,
+                               selfplay_options_t const &options);
+
+void print_selfplay_result(selfplay_result_t const &result, char const *names[2]);
@@ -0,0 +1,157 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Solves the whole game and writes the tablebase.
+//
+// Every move places a piece, so a position with n pieces placed only leads to positions with
+// n + 1, and the game graph splits into layers. The forward pass enumerates the canonical
+// undecided positions of each layer, the backward pass then solves the layers from the last
+// one to the first, looking up each child's value in the layer after it.
+
+constexpr int TOTAL_PIECES = 2 * PIECE_SIZES * PIECES_PER_SIZE;
+
+// Values are from the point of view of the player to move: 0 for a draw, otherwise
+// +-(SOLVED_WIN - plies until the game ends) for a win or loss.
+constexpr int SOLVED_WIN = 32;
+
+struct layer_t {
+	std::vector<uint64_t> states;
+	std::vector<int8_t> values;
+	std::vector<move_t> moves;
+};
+
+int get_terminal_value(game_state_t const &state, int player) {
+	int victor = get_victor(state);
+	if (victor == player) return SOLVED_WIN;
+	if (victor == 1 - player) return -SOLVED_WIN;
+	return 0;
+}
+
+// The child's value is from the opponent's point of view, and one ply further from the end
+int get_parent_value(int child_value) {
+	if (child_value > 0) return -(child_value - 1);
+	if (child_value < 0) return -child_value - 1;
+	return 0;
+}
+
+void expand_layer(layer_t const &layer, int player, layer_t &next) {
+	for (uint64_t bits: layer.states) {
+		game_state_t state = {bits};
+		for (auto const &move: get_valid_moves(state, player, true)) {
+			game_state_t child = get_canonical_state(*perform_move(state, move)).state;
+			if (get_victor(child) == -1) {
+				next.states.push_back(child.words[0]);
+			}
+		}
+	}
+	std::sort(next.states.begin(), next.states.end());
+	next.states.erase(std::unique(next.states.begin(), next.states.end()), next.states.end());
+}
+
+void solve_layer(layer_t &layer, int player, layer_t const &next) {
+	layer.values.resize(layer.states.size());
+	layer.moves.resize(layer.states.size());
+	for (size_t i = 0; i < layer.states.size(); ++i) {
+		game_state_t state = {layer.states[i]};
+		// With no valid move the player has to yield and loses
+		move_t best_move = {player, -1, -1, true};
+		int best_value = -(SOLVED_WIN - 1);
+
+		for (auto const &move: get_valid_moves(state, player, true)) {
+			game_state_t child = get_canonical_state(*perform_move(state, move)).state;
+			int child_value;
+			if (get_victor(child) != -1) {
+				child_value = get_terminal_value(child, 1 - player);
+			} else {
+				auto it = std::lower_bound(next.states.begin(), next.states.end(), child.words[0]);
+				child_value = next.values[it - next.states.begin()];
+			}
+
+			int value = get_parent_value(child_value);
+			if (best_move.yield || value > best_value) {
+				best_move = move;
+				best_value = value;
+			}
+		}
+
+		layer.values[i] = (int8_t) best_value;
+		layer.moves[i] = best_move;
+	}
+}
+
+int main(int argc, char **argv) {
+	char const *path = "tictactoe.tb";
+	if (argc == 2) {
+		path = argv[1];
+	} else if (argc > 2) {
+		printf("Usage: %s [output file]\n", argv[0]);
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<layer_t> layers(TOTAL_PIECES + 1);
+	layers[0].states.push_back(get_canonical_state(get_clear_game_state()).state.words[0]);
+	uint64_t count = 0;
+	for (int ply = 0; ply < TOTAL_PIECES; ++ply) {
+		expand_layer(layers[ply], ply % 2, layers[ply + 1]);
+		count += layers[ply].states.size();
+		printf("Layer %2i: %zu positions\n", ply, layers[ply].states.size());
+	}
+	for (int ply = TOTAL_PIECES - 1; ply >= 0; --ply) {
+		solve_layer(layers[ply], ply % 2, layers[ply + 1]);
+	}
+
+	int root_value = layers[0].values[0];
+	printf("Solved %llu positions: %s for player 1 in %i plies\n", (unsigned long long) count,
+	       root_value > 0 ? "win" : root_value < 0 ? "loss" : "draw",
+	       root_value == 0 ? TOTAL_PIECES : SOLVED_WIN - abs(root_value));
+
+	// Keep the load factor at or below 3/4
+	uint64_t capacity = 1;
+	while (capacity * 3 < count * 4) {
+		capacity *= 2;
+	}
+	std::vector<uint64_t> entries(capacity, 0);
+	for (auto const &layer: layers) {
+		for (size_t i = 0; i < layer.states.size(); ++i) {
+			int value = layer.values[i];
+			auto result = value > 0 ? RESULT_WIN : value < 0 ? RESULT_LOSS : RESULT_DRAW;
+			uint64_t key = layer.states[i];
+			size_t slot = get_tablebase_slot(key, capacity);
+			while (entries[slot] != 0) {
+				slot = (slot + 1) & (capacity - 1);
+			}
+			entries[slot] = pack_tablebase_entry({key}, layer.moves[i], result);
+		}
+	}
+
+	tablebase_header_t header = {};
+	memcpy(header.magic, TABLEBASE_MAGIC, sizeof(TABLEBASE_MAGIC));
+	header.version = TABLEBASE_VERSION;
+	header.entry_size = sizeof(uint64_t);
+	header.capacity = capacity;
+	header.count = count;
+
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		printf("Could not open %s for writing\n", path);
+		return 1;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+	               fwrite(entries.data(), sizeof(uint64_t), capacity, file) == capacity;
+	if (fclose(file) != 0 || !written) {
+		printf("Could not write %s\n", path);
+		return 1;
+	}
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	printf("Wrote %s: %llu entries, %llu bytes in %lld ms\n", path, (unsigned long long) capacity,
+	       (unsigned long long) (sizeof(header) + capacity * sizeof(uint64_t)), (long long) elapsed.count());
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "tablebase.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+tablebase_t tablebase;
+
+bool load_tablebase(tablebase_t &table, char const *path) {
+	unload_tablebase(table);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("Could not open tablebase %s\n", path);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(tablebase_header_t)) {
+		printf("Tablebase %s is truncated\n", path);
+		close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		printf("Could not map tablebase %s\n", path);
+		return false;
+	}
+	// Probes hit random pages, read-ahead would only waste memory
+	madvise(mapping, info.st_size, MADV_RANDOM);
+
+	// The capacity is compared against the entries the file holds rather than multiplied out,
+	// which could overflow for a corrupt header
+	auto header = (tablebase_header_t const *) mapping;
+	size_t file_entries = ((size_t) info.st_size - sizeof(tablebase_header_t)) / sizeof(uint64_t);
+	bool valid = memcmp(header->magic, TABLEBASE_MAGIC, sizeof(TABLEBASE_MAGIC)) == 0 &&
+	             header->version == TABLEBASE_VERSION &&
+	             header->entry_size == sizeof(uint64_t) &&
+	             header->capacity != 0 && (header->capacity & (header->capacity - 1)) == 0 &&
+	             header->capacity == file_entries &&
+	             sizeof(tablebase_header_t) + file_entries * sizeof(uint64_t) == (size_t) info.st_size &&
+	             header->count <= header->capacity;
+	if (!valid) {
+		printf("Tablebase %s is not a valid version %u tablebase\n", path, TABLEBASE_VERSION);
+		munmap(mapping, info.st_size);
+		return false;
+	}
+
+	table.header = header;
+	table.entries = (uint64_t const *) (header + 1);
+	table.mapping = mapping;
+	table.mapping_size = info.st_size;
+	return true;
+}
+
+void unload_tablebase(tablebase_t &table) {
+	if (table.mapping) {
+		munmap(table.mapping, table.mapping_size);
+	}
+	table = {};
+}
+
+std::optional<tablebase_hit_t> probe_tablebase(tablebase_t const &table, game_state_t const &state, int player) {
+	if (!table.entries || get_victor(state) != -1 || get_player_to_move(state) != player) {
+		return std::nullopt;
+	}
+
+	auto canonical = get_canonical_state(state);
+	uint64_t key = canonical.state.words[0];
+	uint64_t capacity = table.header->capacity;
+	size_t slot = get_tablebase_slot(key, capacity);
+	// A corrupt file may have no empty slot, so give up after going around the table once
+	for (uint64_t probes = 0; probes < capacity; ++probes, slot = (slot + 1) & (capacity - 1)) {
+		uint64_t entry = table.entries[slot];
+		if (entry == 0) {
+			return std::nullopt;
+		}
+		if ((entry & TABLEBASE_KEY_MASK) == key) {
+			move_t move = transform_move(get_tablebase_move(entry, player), symmetry_tables.inverse[canonical.symmetry]);
+			return tablebase_hit_t{move, get_tablebase_result(entry)};
+		}
+	}
+	return std::nullopt;
+}
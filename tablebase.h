@@ -0,0 +1,85 @@
+#pragma once
+
+#include "game.h"
+
+#include <cstddef>
+
+// A tablebase file is a tablebase_header_t followed by `capacity` 64-bit entries forming an
+// open-addressed hash table with linear probing, where an empty slot is 0. Every reachable,
+// undecided position is stored once in its canonical orientation: the state bits in the low
+// 57 bits of the entry, and the game-theoretic result and best move in the 7 bits above.
+// The player to move is implied by the number of pieces left.
+constexpr char TABLEBASE_MAGIC[8] = {'T', 'T', 'T', 'B', 'A', 'S', 'E', '\0'};
+constexpr uint32_t TABLEBASE_VERSION = 1;
+
+struct tablebase_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;
+	uint64_t capacity;
+	uint64_t count;
+};
+
+enum tablebase_result_t : uint8_t {
+	RESULT_DRAW,
+	RESULT_WIN,
+	RESULT_LOSS,
+};
+
+// Yield flags are never set in an undecided position, so the value can take their place
+static_assert(game_state_t::WORDS == 1, "tablebase entries hold the state in one word");
+constexpr int TABLEBASE_VALUE_SHIFT = get_state_field<classic_config_t, YIELDED_FIELDS>(0).shift;
+constexpr uint64_t TABLEBASE_KEY_MASK = (1ull << TABLEBASE_VALUE_SHIFT) - 1;
+constexpr int TABLEBASE_YIELD_MOVE = BOARD_TILES * PIECE_SIZES;
+
+static_assert(TABLEBASE_VALUE_SHIFT + 7 <= 64, "tablebase value must fit above the state bits");
+static_assert(TABLEBASE_YIELD_MOVE < 32, "tablebase move code must fit in 5 bits");
+
+inline uint64_t pack_tablebase_entry(game_state_t const &canonical, move_t const &move, tablebase_result_t result) {
+	uint64_t code = move.yield ? TABLEBASE_YIELD_MOVE : move.position * PIECE_SIZES + move.size;
+	return canonical.words[0] | ((code | ((uint64_t) result << 5)) << TABLEBASE_VALUE_SHIFT);
+}
+
+inline move_t get_tablebase_move(uint64_t entry, int player) {
+	int code = (entry >> TABLEBASE_VALUE_SHIFT) & 31;
+	if (code == TABLEBASE_YIELD_MOVE) {
+		return {player, -1, -1, true};
+	}
+	return {player, code % PIECE_SIZES, code / PIECE_SIZES, false};
+}
+
+inline tablebase_result_t get_tablebase_result(uint64_t entry) {
+	return (tablebase_result_t) (entry >> (TABLEBASE_VALUE_SHIFT + 5));
+}
+
+inline size_t get_tablebase_slot(uint64_t key, uint64_t capacity) {
+	return XXH64(&key, sizeof(key), 1) & (capacity - 1);
+}
+
+// The player to move in a position reached from the clear board; player 0 always starts
+inline int get_player_to_move(game_state_t const &state) {
+	return (2 * PIECE_SIZES * PIECES_PER_SIZE - get_remaining_plies(state)) % 2;
+}
+
+struct tablebase_t {
+	tablebase_header_t const *header = nullptr;
+	uint64_t const *entries = nullptr;
+	void *mapping = nullptr;
+	size_t mapping_size = 0;
+};
+
+extern tablebase_t tablebase;
+
+// Maps a tablebase file into memory. The entries are used in place, so this is a single
+// mmap plus a check of the header.
+bool load_tablebase(tablebase_t &table, char const *path);
+
+void unload_tablebase(tablebase_t &table);
+
+struct tablebase_hit_t {
+	move_t move;
+	tablebase_result_t result;
+};
+
+// Perfect move for the position, if it is in the table
+std::optional<tablebase_hit_t> probe_tablebase(tablebase_t const &table, game_state_t const &state, int player);